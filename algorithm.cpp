@@ -3,258 +3,82 @@
 #include <iomanip>
 #include <string>
 #include <fstream>
-#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include "bitcascade.h"
 using namespace std;
 
-const int BLOCK_SIZE = 8; 
-const int TOTAL_ROUNDS = 5;
+FileOptions fileOptions; // --hex, --mmap, --ctr
+unsigned cipherBlockSize = BLOCK_SIZE; // --block-size; decryption takes it from the container
+bool rangeRequested = false; // --range OFFSET:LENGTH: file decryption writes only these plaintext bytes
+uint64_t rangeOffset = 0, rangeLength = 0;
+bool statsRequested = false, statsJson = false; // --stats [text|json]: print the phase statistics on exit
 
-string cleanHexString(const string& hexStr) {
-    string cleaned;
-    for (char c : hexStr) {
-        if (isxdigit(static_cast<unsigned char>(c))) {
-            cleaned += c;
-        }
-    }
-    return cleaned;
-}
-
-bool hexStringToBytes(const string& hexStr, vector<unsigned char>& output) {
-    string cleaned = cleanHexString(hexStr);
-    if (cleaned.length() % 2 != 0) {
-        cout << "Error: Invalid hexadecimal length (must be even)." << endl;
-        return false;
-    }
-    
-    output.clear();
-    for (size_t i = 0; i < cleaned.length(); i += 2) {
-        string byteStr = cleaned.substr(i, 2);
-        try {
-            int value = stoi(byteStr, nullptr, 16);
-            output.push_back(static_cast<unsigned char>(value));
-        } catch (...) {
-            cout << "Error: Invalid hexadecimal found." << endl;
-            return false;
-        }
-    }
-    return true;
-}
-
-string bytesToHexString(const vector<unsigned char>& data) {
-    stringstream ss;
-    ss << hex << setfill('0');
-    for (unsigned char byte : data) {
-        ss << setw(2) << static_cast<int>(byte);
-    }
-    return ss.str();
-}
-
-void printBlock(const vector<unsigned char>& block, const string& label){
-    cout << label << ": ";
-    for(auto b : block){
-        cout << setw(2) << setfill('0') << hex << (int)b << " ";
-    }
-    cout << dec << endl;
-}
-
-unsigned char rotateLeft(unsigned char byte, int n){
-    return (byte << n) | (byte >> (8-n));
-}
-
-unsigned char rotateRight(unsigned char byte, int n){
-    return (byte >> n) | (byte << (8-n));
-}
-
-vector<unsigned char> generateSubkey(const string& key, int round){
-    vector<unsigned char> subkey;
-    for(int i = 0; i < BLOCK_SIZE; i++){
-        subkey.push_back((round + key[i % key.size()] + i * i) % 256);
+void printStats(){
+    if(!statsRequested) return;
+    cout << formatStats(collectStats(), statsJson) << (statsJson ? "\n" : "");
+    if(!statsJson){
+        KeyScheduleCache::Counters cache = sharedKeyCache().counters();
+        cout << "key cache: " << cache.hits << " hits, " << cache.misses << " misses, " << cache.evictions << " evictions" << endl;
     }
-    return subkey;
 }
 
-void confusion(vector<unsigned char> &block, const vector<unsigned char> &subkey, int round){
-    for(int i = 0; i < block.size(); i++){
-        int tmp = ((block[i] ^ subkey[i % subkey.size()]) + i * i + round * 7);
-        block[i] = (tmp % 256 + 256) % 256;
-    }
-}
-
-void difusion(vector<unsigned char> &block){
-    for(int i = 0; i < block.size(); i++){
-        block[i] = rotateLeft(block[i], i + 1);
-    }
-
-    for(int i = 1; i < block.size(); i++){
-        block[i] ^= block[i - 1];
-    }
-
-    vector<unsigned char> temp(block.size());
-    for (int i = 0; i < block.size(); i++){
-        int j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
-        temp[j] = block[i];
-    }
-    block = temp;
-}
-
-void inverseDifusion(vector<unsigned char> &block){
-    vector<unsigned char> temp(block.size());
-    for (int i = 0; i < block.size(); i++){
-        int j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
-        temp[i] = block[j];
-    }
-
-    for(int i = temp.size() - 1; i >= 1; i--){
-        temp[i] ^= temp[i - 1];
-    }
-    
-    for(int i = 0; i < (int)temp.size(); i++){
-        temp[i] = rotateRight(temp[i], i + 1);
-    }
-    block = temp;
-}
-
-void inverseConfusion(vector<unsigned char> &block, const vector<unsigned char> &subkey, int round){
-    for(int i = 0; i < block.size(); i++){
-        int tmp = (int)block[i] - (int)(i * i) - round * 7;
-        tmp = (tmp % 256 + 256) % 256;
-        block[i] = (unsigned char)(tmp ^ subkey[i % subkey.size()]);
-    }
-}
-
-vector<unsigned char> encryptBlock(vector<unsigned char> block, const string &key){
-    for(int round = 0; round < TOTAL_ROUNDS; round++){
-        vector<unsigned char> subkey = generateSubkey(key, round);
-        confusion(block, subkey, round);
-        difusion(block);
-    }
-    return block;
-}
-
-vector<unsigned char> decryptBlock(vector<unsigned char> block, const string &key){
-    for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
-        vector<unsigned char> subkey = generateSubkey(key, round);
-        inverseDifusion(block);
-        inverseConfusion(block, subkey, round);
-    }
-    return block;
+// Parses "OFFSET:LENGTH" (decimal byte counts)
+bool parseRange(const string& text, uint64_t& offset, uint64_t& length){
+    size_t colon = text.find(':');
+    if(colon == string::npos || colon == 0 || colon + 1 == text.size()) return false;
+    char* end = nullptr;
+    offset = strtoull(text.c_str(), &end, 10);
+    if(end != text.c_str() + colon) return false;
+    length = strtoull(text.c_str() + colon + 1, &end, 10);
+    return *end == '\0';
 }
 
-vector<unsigned char> padBlock(const vector<unsigned char>& data){
-    vector<unsigned char> padded = data;
-    int padding = BLOCK_SIZE - (data.size() % BLOCK_SIZE);
-    if(padding == BLOCK_SIZE) padding = 0;
-    
-    for(int i = 0; i < padding; i++){
-        padded.push_back(static_cast<unsigned char>(padding));
-    }
-    return padded;
-}
-
-vector<unsigned char> unpadBlock(const vector<unsigned char>& data){
-    if(data.empty()) return data;
-    
-    unsigned char padding = data[data.size() - 1];
-    if(padding > 0 && padding <= BLOCK_SIZE){
-        for(size_t i = data.size() - padding; i < data.size(); i++){
-            if(data[i] != padding){
-                return data; 
-            }
-        }
-        vector<unsigned char> unpadded = data;
-        unpadded.resize(data.size() - padding);
-        return unpadded;
-    }
-    return data;
-}
-
-vector<vector<unsigned char>> splitIntoBlocks(const vector<unsigned char>& data){
-    vector<vector<unsigned char>> blocks;
-    
-    for(size_t i = 0; i < data.size(); i += BLOCK_SIZE){
-        vector<unsigned char> block;
-        for(int j = 0; j < BLOCK_SIZE && i + j < data.size(); j++){
-            block.push_back(data[i + j]);
-        }
-        blocks.push_back(block);
-    }
-    
-    return blocks;
-}
-
-vector<unsigned char> encryptText(const string& text, const string& key){
-    vector<unsigned char> data(text.begin(), text.end());
-    vector<unsigned char> padded = padBlock(data);
-    vector<vector<unsigned char>> blocks = splitIntoBlocks(padded);
-    
-    vector<unsigned char> encrypted;
-    for(auto& block : blocks){
-        vector<unsigned char> encryptedBlock = encryptBlock(block, key);
-        encrypted.insert(encrypted.end(), encryptedBlock.begin(), encryptedBlock.end());
-    }
-    
-    return encrypted;
-}
-
-string decryptText(const vector<unsigned char>& encrypted, const string& key, bool& validKey) {
-    vector<vector<unsigned char>> blocks = splitIntoBlocks(encrypted);
-    
-    vector<unsigned char> decrypted;
-    for(auto& block : blocks) {
-        vector<unsigned char> decryptedBlock = decryptBlock(block, key);
-        decrypted.insert(decrypted.end(), decryptedBlock.begin(), decryptedBlock.end());
-    }
-    
-    validKey = false;
-    
-    if(decrypted.empty()) {
-        return "";  
-    }
-    
-    unsigned char padding = decrypted[decrypted.size() - 1];
-    
-    if(padding > 0 && padding <= BLOCK_SIZE) {
-        if(decrypted.size() >= padding) {
-            validKey = true;
-            for(size_t i = decrypted.size() - padding; i < decrypted.size(); i++) {
-                if(decrypted[i] != padding) {
-                    validKey = false;
-                    break;
-                }
-            }
-        }
-    }
-    
-    if(validKey) {
-        vector<unsigned char> unpadded = decrypted;
-        unpadded.resize(decrypted.size() - padding);
-        return string(unpadded.begin(), unpadded.end());
-    }
-    return "";
-}
-
-bool saveToFile(const string& filename, const string& content){
-    ofstream file(filename);
-    if(!file.is_open()){
+// decryptFile, or decryptFileRange when --range was given; nothing is written on failure
+bool decryptFileOrRange(const string& inputName, const string& outputName, const KeySchedule& schedule, bool& validKey){
+    if(!rangeRequested) return decryptFile(inputName, outputName, schedule, validKey, fileOptions);
+    vector<unsigned char> plaintext;
+    if(!decryptFileRange(inputName, rangeOffset, rangeLength, plaintext, schedule, validKey) || !validKey) return false;
+    ofstream output(outputName, ios::binary | ios::trunc);
+    if(!output.is_open()){
         cout << "Error: Could not open file for writing." << endl;
         return false;
     }
-    file << content;
-    file.close();
-    return true;
+    output.write((const char*)plaintext.data(), plaintext.size());
+    return (bool)output;
 }
 
-bool readFromFile(const string& filename, string& content){
-    ifstream file(filename);
-    if(!file.is_open()){
-        cout << "Error: Could not open file for reading." << endl;
-        return false;
-    }
-    stringstream buffer;
-    buffer << file.rdbuf();
-    content = buffer.str();
-    file.close();
-    return true;
+// Encrypts sizeMB of data with 1, 2, 4, ... threads and prints the scaling curve
+void benchmarkThreadScaling(size_t sizeMB){
+    size_t blockCount = sizeMB * 1024 * 1024 / BLOCK_SIZE;
+    vector<unsigned char> buffer(blockCount * BLOCK_SIZE, 0x5A);
+    KeySchedule schedule("benchmark-key");
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+    if(sharedPoolThreads() > 0) maxThreads = sharedPoolThreads();
+
+    cout << "Backend: " << blockBackend().name << ", data: " << sizeMB << " MB" << endl;
+    cout << "threads      MB/s   speedup  efficiency" << endl;
+    double baseline = 0;
+    for(unsigned threads = 1; ; threads = min(threads * 2, maxThreads)){
+        WorkStealingPool pool(threads);
+        parallelEncryptBlocks(buffer.data(), buffer.data(), blockCount, schedule, pool); // warm-up
+        auto start = chrono::steady_clock::now();
+        parallelEncryptBlocks(buffer.data(), buffer.data(), blockCount, schedule, pool);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double mbPerSecond = sizeMB / seconds;
+        if(threads == 1) baseline = mbPerSecond;
+        double speedup = mbPerSecond / baseline;
+        cout << setw(7) << threads << setw(10) << fixed << setprecision(1) << mbPerSecond
+             << setw(10) << setprecision(2) << speedup << setw(11) << setprecision(0) << speedup / threads * 100 << "%" << endl;
+        if(threads == maxThreads) break;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
 }
 
 void encryptMenu(){
@@ -283,7 +107,10 @@ void encryptMenu(){
     }
     
     cout << "\nProcessing..." << endl;
-    vector<unsigned char> encrypted = encryptText(text, key);
+    KeySchedule schedule(key, cipherBlockSize);
+    ContainerHeader header = makeContainerHeader(text.size(), schedule, fileOptions.mode);
+    vector<unsigned char> encrypted = header.mode == MODE_CTR ? encryptTextCtr(text, schedule, header.nonce)
+                                                              : encryptText(text, schedule);
     string hexResult = bytesToHexString(encrypted);
     
     cout << "Text encrypted successfully!" << endl;
@@ -295,7 +122,7 @@ void encryptMenu(){
     cout << "\nEnter filename to save encrypted text: ";
     getline(cin, filename);
     
-    if(saveToFile(filename, hexResult)){
+    if(saveCiphertext(filename, encrypted, header, fileOptions)){
         cout << "Encrypted text saved to: " << filename << endl;
     } else {
         cout << "Failed to save file." << endl;
@@ -309,8 +136,8 @@ void decryptMenu(){
     cout << "Enter filename with encrypted text: ";
     getline(cin, filename);
     
-    string hexContent;
-    if(!readFromFile(filename, hexContent)){
+    string content;
+    if(!readFromFile(filename, content)){
         cout << "Could not read file: " << filename << endl;
         return;
     }
@@ -324,14 +151,24 @@ void decryptMenu(){
     }
     
     vector<unsigned char> encryptedData;
-    if(!hexStringToBytes(hexContent, encryptedData)){
-        cout << "Invalid hexadecimal format in file." << endl;
+    ContainerHeader header;
+    bool hasHeader;
+    if(!parseCiphertext(content, encryptedData, header, hasHeader)){
+        cout << "Invalid ciphertext format in file." << endl;
         return;
     }
     
     cout << "\nDecrypting..." << endl;
-    bool validKey;
-    string decryptedText = decryptText(encryptedData, key, validKey);
+    bool validKey = false;
+    KeySchedule schedule(key, hasHeader ? header.blockSize : BLOCK_SIZE);
+    string decryptedText;
+    if(hasHeader && header.mode == MODE_CTR){
+        // CTR has no padding to check, only the key check value
+        validKey = header.keyCheck == keyCheckValue(schedule);
+        if(validKey) decryptedText = decryptTextCtr(encryptedData, schedule, header.nonce);
+    } else if(!hasHeader || header.keyCheck == keyCheckValue(schedule)){
+        decryptedText = decryptText(encryptedData, schedule, validKey);
+    }
     
     if(!validKey || decryptedText.empty()){
         cout << "DECRYPTION FAILED: Invalid key or corrupted data!" << endl;
@@ -343,14 +180,325 @@ void decryptMenu(){
     }
 }
 
-int main(){
+void encryptFileMenu(){
+    string inputName, outputName, key;
+    cout << "\n=== ENCRYPT FILE ===" << endl;
+    
+    cout << "Enter file to encrypt: ";
+    getline(cin, inputName);
+    cout << "Enter filename to save encrypted file: ";
+    getline(cin, outputName);
+    
+    cout << "Enter key (max 16 characters): ";
+    getline(cin, key);
+    
+    if(key.length() > 16){
+        key = key.substr(0, 16);
+        cout << "Key truncated to 16 characters." << endl;
+    }
+    
+    if(key.empty()){
+        cout << "Error: Key cannot be empty." << endl;
+        return;
+    }
+    
+    cout << "\nProcessing..." << endl;
+    KeySchedule schedule(key, cipherBlockSize);
+    if(encryptFile(inputName, outputName, schedule, fileOptions)){
+        cout << "File encrypted successfully!" << endl;
+        cout << "Encrypted file saved to: " << outputName << endl;
+    } else {
+        cout << "Failed to encrypt file." << endl;
+    }
+}
+
+void decryptFileMenu(){
+    string inputName, outputName, key;
+    cout << "\n=== DECRYPT FILE ===" << endl;
+    
+    cout << "Enter filename with encrypted file: ";
+    getline(cin, inputName);
+    cout << "Enter filename to save decrypted file: ";
+    getline(cin, outputName);
+    
+    cout << "Enter decryption key: ";
+    getline(cin, key);
+    
+    if(key.empty()){
+        cout << "Error: Key cannot be empty." << endl;
+        return;
+    }
+    
+    cout << "\nDecrypting..." << endl;
+    KeySchedule schedule(key);
+    bool validKey;
+    
+    if(decryptFileOrRange(inputName, outputName, schedule, validKey)){
+        cout << "Decryption successful!" << endl;
+        cout << "Decrypted file saved to: " << outputName << endl;
+    } else {
+        cout << "DECRYPTION FAILED: Invalid key or corrupted data!" << endl;
+    }
+}
+
+// ===================== BATCH MODE =====================
+// --batch <manifest> --keys <keyfile> [--summary <json>] processes every manifest
+// entry in this one process. Manifest lines are tab-separated:
+//     input  output  key-id  [encrypt|decrypt]
+// and the key file holds "key-id<TAB>key" lines. Lines starting with # are ignored.
+// Each distinct key is expanded once and files run in parallel on the shared pool.
+
+struct BatchEntry {
+    string input, output, keyId;
+    bool encrypt = true;
+    string status = "pending";
+    uint64_t bytes = 0;
+    double milliseconds = 0;
+};
+
+vector<string> splitFields(const string& line){
+    vector<string> fields;
+    size_t start = 0;
+    while(true){
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == string::npos ? string::npos : tab - start));
+        if(tab == string::npos) return fields;
+        start = tab + 1;
+    }
+}
+
+// Calls handle(lineNumber, fields) for every non-empty, non-comment line
+bool readTabFile(const string& filename, const function<bool(int, const vector<string>&)>& handle){
+    ifstream file(filename);
+    if(!file.is_open()){
+        cout << "Error: Could not open " << filename << " for reading." << endl;
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while(getline(file, line)){
+        lineNumber++;
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty() || line[0] == '#') continue;
+        if(!handle(lineNumber, splitFields(line))) return false;
+    }
+    return true;
+}
+
+bool readKeyFile(const string& filename, map<string, string>& keys){
+    return readTabFile(filename, [&](int lineNumber, const vector<string>& fields){
+        if(fields.size() != 2 || fields[1].empty()){
+            cout << "Error: " << filename << ":" << lineNumber << ": expected key-id<TAB>key." << endl;
+            return false;
+        }
+        keys[fields[0]] = fields[1].substr(0, 16);
+        return true;
+    });
+}
+
+bool readManifest(const string& filename, vector<BatchEntry>& entries){
+    return readTabFile(filename, [&](int lineNumber, const vector<string>& fields){
+        if(fields.size() < 3 || fields.size() > 4 || (fields.size() == 4 && fields[3] != "encrypt" && fields[3] != "decrypt")){
+            cout << "Error: " << filename << ":" << lineNumber << ": expected input<TAB>output<TAB>key-id[<TAB>encrypt|decrypt]." << endl;
+            return false;
+        }
+        BatchEntry entry;
+        entry.input = fields[0];
+        entry.output = fields[1];
+        entry.keyId = fields[2];
+        entry.encrypt = fields.size() == 3 || fields[3] == "encrypt";
+        entries.push_back(entry);
+        return true;
+    });
+}
+
+string jsonEscape(const string& text){
+    string escaped;
+    for(unsigned char c : text){
+        if(c == '"' || c == '\\'){
+            escaped += '\\';
+            escaped += (char)c;
+        } else if(c < 0x20){
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    return escaped;
+}
+
+void writeBatchSummary(ostream& out, const vector<BatchEntry>& entries, double seconds){
+    size_t failed = 0;
+    uint64_t totalBytes = 0;
+    for(const BatchEntry& entry : entries){
+        if(entry.status != "ok") failed++;
+        totalBytes += entry.bytes;
+    }
+    out << "{\n  \"files\": " << entries.size() << ",\n  \"failed\": " << failed
+        << ",\n  \"bytes\": " << totalBytes << ",\n  \"seconds\": " << fixed << setprecision(3) << seconds
+        << ",\n  \"backend\": \"" << blockBackend().name << "\"";
+    KeyScheduleCache::Counters cache = sharedKeyCache().counters();
+    out << ",\n  \"key_cache\": {\"hits\": " << cache.hits << ", \"misses\": " << cache.misses
+        << ", \"evictions\": " << cache.evictions << "},\n  \"entries\": [";
+    for(size_t i = 0; i < entries.size(); i++){
+        const BatchEntry& entry = entries[i];
+        out << (i ? "," : "") << "\n    {\"input\": \"" << jsonEscape(entry.input)
+            << "\", \"output\": \"" << jsonEscape(entry.output)
+            << "\", \"key_id\": \"" << jsonEscape(entry.keyId)
+            << "\", \"operation\": \"" << (entry.encrypt ? "encrypt" : "decrypt")
+            << "\", \"status\": \"" << entry.status
+            << "\", \"bytes\": " << entry.bytes
+            << ", \"ms\": " << setprecision(3) << entry.milliseconds << "}";
+    }
+    out << "\n  ]\n}" << endl;
+    out.unsetf(ios::fixed);
+}
+
+uint64_t fileSize(const string& filename){
+    ifstream file(filename, ios::binary | ios::ate);
+    return file.is_open() ? (uint64_t)file.tellg() : 0;
+}
+
+int runBatch(const string& manifestName, const string& keysName, const string& summaryName){
+    map<string, string> keys;
+    vector<BatchEntry> entries;
+    if(!readKeyFile(keysName, keys) || !readManifest(manifestName, entries)) return 1;
+    
+    auto start = chrono::steady_clock::now();
+    // Key ids that share a key also share one cached schedule
+    map<string, shared_ptr<const KeySchedule>> schedules;
+    for(const BatchEntry& entry : entries){
+        auto key = keys.find(entry.keyId);
+        if(key != keys.end() && schedules.find(entry.keyId) == schedules.end()){
+            schedules.emplace(entry.keyId, sharedKeyCache().get(key->second, cipherBlockSize));
+        }
+    }
+    
+    sharedPool().parallelFor(entries.size(), [&](size_t i){
+        BatchEntry& entry = entries[i];
+        auto fileStart = chrono::steady_clock::now();
+        auto schedule = schedules.find(entry.keyId);
+        if(schedule == schedules.end()){
+            entry.status = "unknown-key-id";
+            return;
+        }
+        entry.bytes = fileSize(entry.input);
+        if(entry.encrypt){
+            entry.status = encryptFile(entry.input, entry.output, *schedule->second, fileOptions) ? "ok" : "failed";
+        } else {
+            bool validKey;
+            bool ok = decryptFileOrRange(entry.input, entry.output, *schedule->second, validKey);
+            entry.status = ok ? "ok" : (validKey ? "failed" : "invalid-key-or-data");
+        }
+        entry.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - fileStart).count();
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    bool allOk = true;
+    for(const BatchEntry& entry : entries){
+        if(entry.status != "ok") allOk = false;
+    }
+    if(summaryName.empty()){
+        writeBatchSummary(cout, entries, seconds);
+    } else {
+        ofstream summary(summaryName, ios::trunc);
+        if(!summary.is_open()){
+            cout << "Error: Could not open " << summaryName << " for writing." << endl;
+            return 1;
+        }
+        writeBatchSummary(summary, entries, seconds);
+    }
+    return allOk ? 0 : 1;
+}
+
+void listBackends(){
+    cout << "Block backends (fastest first):" << endl;
+    for(size_t i = 0; i < BLOCK_BACKEND_COUNT; i++){
+        const BlockBackend& backend = BLOCK_BACKENDS[i];
+        cout << "  " << backend.name;
+        if(!backend.supported()) cout << " (not supported by this CPU)";
+        if(&backend == &blockBackend()) cout << " [active]";
+        cout << endl;
+    }
+}
+
+int main(int argc, char* argv[]){
+    string batchManifest, batchKeys, batchSummary;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "--backend" && i + 1 < argc){
+            if(!selectBackend(argv[++i])){
+                cout << "Error: Backend " << argv[i] << " is not available (see --list-backends)." << endl;
+                return 1;
+            }
+        } else if(arg == "--hex"){
+            fileOptions.hexOutput = true;
+        } else if(arg == "--block-size" && i + 1 < argc){
+            cipherBlockSize = (unsigned)atoi(argv[++i]);
+            if(!isSupportedBlockSize(cipherBlockSize)){
+                cout << "Error: --block-size must be 8, 16, 32 or 64." << endl;
+                return 1;
+            }
+        } else if(arg == "--mmap"){
+            fileOptions.mapped = true;
+        } else if(arg == "--ctr"){
+            fileOptions.mode = MODE_CTR;
+        } else if(arg == "--range" && i + 1 < argc){
+            rangeRequested = parseRange(argv[++i], rangeOffset, rangeLength);
+            if(!rangeRequested){
+                cout << "Error: --range expects OFFSET:LENGTH in bytes." << endl;
+                return 1;
+            }
+        } else if(arg == "--stats"){
+            statsRequested = true;
+            if(i + 1 < argc && (string(argv[i + 1]) == "json" || string(argv[i + 1]) == "text")){
+                statsJson = string(argv[++i]) == "json";
+            }
+        } else if(arg == "--threads" && i + 1 < argc){
+            setSharedPoolThreads((unsigned)atoi(argv[++i]));
+        } else if(arg == "--batch" && i + 1 < argc){
+            batchManifest = argv[++i];
+        } else if(arg == "--keys" && i + 1 < argc){
+            batchKeys = argv[++i];
+        } else if(arg == "--summary" && i + 1 < argc){
+            batchSummary = argv[++i];
+        } else if(arg == "--list-backends"){
+            listBackends();
+            return 0;
+        } else if(arg == "--bench-threads"){
+            size_t sizeMB = (i + 1 < argc) ? (size_t)atoll(argv[++i]) : 256;
+            benchmarkThreadScaling(max<size_t>(1, sizeMB));
+            return 0;
+        } else {
+            cout << "Usage: " << argv[0] << " [--backend avx512|avx2|sse2|unrolled|table|word|scalar] [--threads N] [--block-size 8|16|32|64] [--ctr] [--hex] [--mmap] [--range OFFSET:LENGTH] [--stats [text|json]]" << endl;
+            cout << "       " << argv[0] << " --list-backends" << endl;
+            cout << "       " << argv[0] << " [--threads N] --bench-threads [MB]" << endl;
+            cout << "       " << argv[0] << " [options] --batch MANIFEST --keys KEYFILE [--summary SUMMARY.json]" << endl;
+            return 1;
+        }
+    }
+    
+    if(!batchManifest.empty() || !batchKeys.empty()){
+        if(batchManifest.empty() || batchKeys.empty()){
+            cout << "Error: --batch and --keys must be given together." << endl;
+            return 1;
+        }
+        int status = runBatch(batchManifest, batchKeys, batchSummary);
+        printStats();
+        return status;
+    }
+    
     int choice;
     
     do {
         cout << "\n=== BITCASCADE ENCRYPTION SYSTEM ===" << endl;
         cout << "1. Encrypt Text" << endl;
         cout << "2. Decrypt Text" << endl;
-        cout << "3. Exit" << endl;
+        cout << "3. Encrypt File" << endl;
+        cout << "4. Decrypt File" << endl;
+        cout << "5. Exit" << endl;
         cout << "Choose option: ";
         cin >> choice;
         cin.ignore(); // Clear newline
@@ -363,13 +511,20 @@ int main(){
                 decryptMenu();
                 break;
             case 3:
+                encryptFileMenu();
+                break;
+            case 4:
+                decryptFileMenu();
+                break;
+            case 5:
                 cout << "Thank you for using BitCascade!" << endl;
                 break;
             default:
                 cout << "Invalid option. Please try again." << endl;
         }
         
-    } while(choice != 3);
+    } while(choice != 5);
     
+    printStats();
     return 0;
-}
\ No newline at end of file
+}
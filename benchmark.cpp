@@ -0,0 +1,435 @@
+// Microbenchmarks for every cipher primitive, with hardware counters where available.
+//
+//   benchmark.exe [--backend NAME|all] [--min-size N] [--max-size N] [--min-time SECONDS]
+//                 [--threads N] [--output FILE]
+//
+// Block primitives run on one 8-byte block; encryptText/decryptText and the hex codec
+// sweep sizes from --min-size to --max-size (steps of 4x, default 8 B .. 1 GB). Results
+// are written as JSON. Counters come from perf_event_open and only cover the calling
+// thread, so they are most meaningful with the default --threads 1.
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "bitcascade.h"
+#if defined(__linux__)
+#define BENCHMARK_PERF 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#define BENCHMARK_TSC 1
+#endif
+using namespace std;
+
+// Keeps the compiler from optimizing a result away
+template<typename T>
+inline void doNotOptimize(T& value){
+#if defined(__GNUC__)
+    asm volatile("" : "+m"(value) : : "memory");
+#else
+    volatile T sink = value;
+    (void)sink;
+#endif
+}
+
+// ===================== HARDWARE COUNTERS =====================
+
+enum CounterIndex { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_COUNT };
+
+struct CounterValues {
+    bool valid[COUNTER_COUNT] = {false, false, false, false};
+    double value[COUNTER_COUNT] = {0, 0, 0, 0};
+};
+
+class PerfCounters {
+public:
+    PerfCounters(){
+#ifdef BENCHMARK_PERF
+        const uint64_t configs[COUNTER_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        for(int i = 0; i < COUNTER_COUNT; i++){
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    ~PerfCounters(){
+#ifdef BENCHMARK_PERF
+        for(int fd : fds) if(fd >= 0) close(fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const {
+        for(int fd : fds) if(fd >= 0) return true;
+        return false;
+    }
+
+    void start(){
+#ifdef BENCHMARK_PERF
+        for(int fd : fds){
+            if(fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    CounterValues stop(){
+        CounterValues values;
+#ifdef BENCHMARK_PERF
+        for(int i = 0; i < COUNTER_COUNT; i++){
+            if(fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t data[3]; // value, time enabled, time running
+            if(read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0) continue;
+            // Scale up if the kernel multiplexed the counter
+            values.value[i] = (double)data[0] * ((double)data[1] / (double)data[2]);
+            values.valid[i] = true;
+        }
+#endif
+        return values;
+    }
+
+private:
+    int fds[COUNTER_COUNT] = {-1, -1, -1, -1};
+};
+
+// ===================== MEASUREMENT =====================
+
+struct BenchmarkResult {
+    string name;
+    string backend;
+    size_t bytes = 0;
+    uint64_t iterations = 0;
+    double seconds = 0;
+    double tscCycles = 0;
+    CounterValues counters;
+};
+
+struct BenchmarkSettings {
+    double minSeconds = 0.2;
+    size_t minSize = 8;
+    size_t maxSize = (size_t)1 << 30;
+    unsigned threads = 1;
+};
+
+inline uint64_t readTsc(){
+#ifdef BENCHMARK_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Runs op in batches that double in size until one batch takes at least minSeconds
+BenchmarkResult measure(const string& name, size_t bytes, const function<void()>& op,
+                        const BenchmarkSettings& settings, PerfCounters& counters){
+    BenchmarkResult result;
+    result.name = name;
+    result.backend = blockBackend().name;
+    result.bytes = bytes;
+    op(); // warm-up
+    for(uint64_t iterations = 1; ; iterations *= 2){
+        counters.start();
+        uint64_t tscStart = readTsc();
+        auto start = chrono::steady_clock::now();
+        for(uint64_t i = 0; i < iterations; i++) op();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        uint64_t tscEnd = readTsc();
+        CounterValues values = counters.stop();
+        if(seconds >= settings.minSeconds || iterations >= ((uint64_t)1 << 40)){
+            result.iterations = iterations;
+            result.seconds = seconds;
+            result.tscCycles = (double)(tscEnd - tscStart);
+            result.counters = values;
+            return result;
+        }
+    }
+}
+
+void writeNumber(ostream& out, const char* key, double value, bool valid = true){
+    out << ", \"" << key << "\": ";
+    if(valid) out << value; else out << "null";
+}
+
+void writeResult(ostream& out, const BenchmarkResult& result){
+    double ops = (double)result.iterations;
+    double totalBytes = ops * (double)result.bytes;
+    const CounterValues& c = result.counters;
+    // Core cycles when the counter works, TSC (reference) cycles otherwise
+    bool coreCycles = c.valid[CYCLES];
+    double cycles = coreCycles ? c.value[CYCLES] : result.tscCycles;
+
+    out << "    {\"name\": \"" << result.name << "\", \"backend\": \"" << result.backend
+        << "\", \"bytes\": " << result.bytes << ", \"iterations\": " << result.iterations;
+    writeNumber(out, "ns_per_op", result.seconds * 1e9 / ops);
+    writeNumber(out, "mb_per_s", totalBytes / result.seconds / 1e6);
+    writeNumber(out, "cycles_per_byte", cycles / totalBytes, cycles > 0);
+    out << ", \"cycle_source\": \"" << (coreCycles ? "core" : (cycles > 0 ? "tsc" : "none")) << "\"";
+    writeNumber(out, "ipc", c.value[INSTRUCTIONS] / c.value[CYCLES], c.valid[INSTRUCTIONS] && c.valid[CYCLES] && c.value[CYCLES] > 0);
+    writeNumber(out, "cache_misses_per_op", c.value[CACHE_MISSES] / ops, c.valid[CACHE_MISSES]);
+    writeNumber(out, "branch_misses_per_op", c.value[BRANCH_MISSES] / ops, c.valid[BRANCH_MISSES]);
+    out << "}";
+}
+
+// ===================== BENCHMARKS =====================
+
+void benchmarkPrimitives(const BenchmarkSettings& settings, PerfCounters& counters, vector<BenchmarkResult>& results){
+    const string key = "benchmark-key";
+    KeySchedule schedule(key);
+    vector<unsigned char> block = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    int round = 0;
+
+    results.push_back(measure("generateSubkey", BLOCK_SIZE, [&]{
+        vector<unsigned char> subkey = generateSubkey(key, round);
+        doNotOptimize(subkey);
+    }, settings, counters));
+    results.push_back(measure("KeySchedule", BLOCK_SIZE * TOTAL_ROUNDS, [&]{
+        KeySchedule expanded(key);
+        doNotOptimize(expanded);
+    }, settings, counters));
+    KeyScheduleCache cache;
+    results.push_back(measure("KeyScheduleCache hit", BLOCK_SIZE * TOTAL_ROUNDS, [&]{
+        shared_ptr<const KeySchedule> cached = cache.get(key);
+        doNotOptimize(cached);
+    }, settings, counters));
+    results.push_back(measure("confusion", BLOCK_SIZE, [&]{
+        confusion(block, schedule.subkeys[round], round);
+        doNotOptimize(block);
+    }, settings, counters));
+    results.push_back(measure("difusion", BLOCK_SIZE, [&]{
+        difusion(block);
+        doNotOptimize(block);
+    }, settings, counters));
+    results.push_back(measure("inverseDifusion", BLOCK_SIZE, [&]{
+        inverseDifusion(block);
+        doNotOptimize(block);
+    }, settings, counters));
+    results.push_back(measure("encryptBlock", BLOCK_SIZE, [&]{
+        block = encryptBlock(block, schedule);
+        doNotOptimize(block);
+    }, settings, counters));
+    results.push_back(measure("decryptBlock", BLOCK_SIZE, [&]{
+        block = decryptBlock(block, schedule);
+        doNotOptimize(block);
+    }, settings, counters));
+    uint64_t word = 0x0123456789ABCDEFULL;
+    results.push_back(measure("encryptBlockWord", BLOCK_SIZE, [&]{
+        word = encryptBlockWord(word, schedule);
+        doNotOptimize(word);
+    }, settings, counters));
+}
+
+// minSize, 4 * minSize, 16 * minSize, ... and finally maxSize itself
+vector<size_t> sweepSizes(const BenchmarkSettings& settings){
+    vector<size_t> sizes;
+    for(size_t size = settings.minSize; size < settings.maxSize; size *= 4){
+        sizes.push_back(size);
+        if(size > settings.maxSize / 4) break;
+    }
+    sizes.push_back(settings.maxSize);
+    return sizes;
+}
+
+void benchmarkText(const BenchmarkSettings& settings, PerfCounters& counters, vector<BenchmarkResult>& results){
+    KeySchedule schedule("benchmark-key");
+    for(size_t size : sweepSizes(settings)){
+        string text(size, 'A');
+        for(size_t i = 0; i < size; i++) text[i] = (char)(i * 131 + 7);
+        vector<unsigned char> encrypted;
+        results.push_back(measure("encryptText", size, [&]{
+            encrypted = encryptText(text, schedule);
+            doNotOptimize(encrypted);
+        }, settings, counters));
+        results.push_back(measure("decryptText", size, [&]{
+            bool validKey;
+            string decrypted = decryptText(encrypted, schedule, validKey);
+            doNotOptimize(decrypted);
+        }, settings, counters));
+        // Zero-copy path for comparison: no allocation per call
+        results.push_back(measure("encryptInto", size, [&]{
+            size_t written = encryptInto(Span<const uint8_t>((const uint8_t*)text.data(), text.size()), encrypted, schedule);
+            doNotOptimize(written);
+        }, settings, counters));
+        // Counter mode: no padding, keystream generated in place
+        results.push_back(measure("ctrCrypt", size, [&]{
+            ctrCrypt(Span<const uint8_t>((const uint8_t*)text.data(), text.size()), Span<uint8_t>(encrypted.data(), size), schedule, 1);
+            doNotOptimize(encrypted);
+        }, settings, counters));
+        cerr << "  text " << size << " bytes (" << blockBackend().name << ")" << endl;
+    }
+}
+
+// Many 100-byte messages under different keys: one encryptInto per message against one
+// encryptMany over the whole batch, which packs the blocks of every key into shared lanes
+void benchmarkBatch(const BenchmarkSettings& settings, PerfCounters& counters, vector<BenchmarkResult>& results){
+    const size_t messageCount = 1024, messageSize = 100, keyCount = 64;
+    vector<KeySchedule> schedules;
+    for(size_t k = 0; k < keyCount; k++) schedules.emplace_back("benchmark-key-" + to_string(k));
+    string text(messageCount * messageSize, 'A');
+    for(size_t i = 0; i < text.size(); i++) text[i] = (char)(i * 131 + 7);
+    const size_t slot = encryptedSize(messageSize);
+    vector<unsigned char> encrypted(messageCount * slot), decrypted(messageCount * slot);
+    vector<BatchMessage> batch(messageCount), reverse(messageCount);
+    for(size_t m = 0; m < messageCount; m++){
+        batch[m].in = Span<const uint8_t>((const uint8_t*)text.data() + m * messageSize, messageSize);
+        batch[m].out = Span<uint8_t>(encrypted.data() + m * slot, slot);
+        batch[m].schedule = &schedules[m % keyCount];
+        reverse[m].in = batch[m].out;
+        reverse[m].out = Span<uint8_t>(decrypted.data() + m * slot, slot);
+        reverse[m].schedule = batch[m].schedule;
+    }
+    results.push_back(measure("encryptInto per message", text.size(), [&]{
+        for(BatchMessage& message : batch) message.written = encryptInto(message.in, message.out, *message.schedule);
+        doNotOptimize(encrypted);
+    }, settings, counters));
+    results.push_back(measure("encryptMany", text.size(), [&]{
+        encryptMany(batch);
+        doNotOptimize(encrypted);
+    }, settings, counters));
+    results.push_back(measure("decryptInto per message", text.size(), [&]{
+        for(BatchMessage& message : reverse){
+            message.written = decryptInto(message.in, message.out, *message.schedule, message.validKey);
+        }
+        doNotOptimize(decrypted);
+    }, settings, counters));
+    results.push_back(measure("decryptMany", text.size(), [&]{
+        decryptMany(reverse);
+        doNotOptimize(decrypted);
+    }, settings, counters));
+    cerr << "  batch of " << messageCount << " x " << messageSize << " bytes (" << blockBackend().name << ")" << endl;
+}
+
+void benchmarkHex(const BenchmarkSettings& settings, PerfCounters& counters, vector<BenchmarkResult>& results){
+    for(size_t size : sweepSizes(settings)){
+        vector<unsigned char> bytes(size);
+        for(size_t i = 0; i < size; i++) bytes[i] = (unsigned char)(i * 131 + 7);
+        string hexText;
+        results.push_back(measure("bytesToHexString", size, [&]{
+            hexText = bytesToHexString(bytes);
+            doNotOptimize(hexText);
+        }, settings, counters));
+        // Throughput of the decoder is reported per decoded byte, like the encoder
+        vector<unsigned char> decoded;
+        results.push_back(measure("hexStringToBytes", size, [&]{
+            hexStringToBytes(hexText, decoded);
+            doNotOptimize(decoded);
+        }, settings, counters));
+        cerr << "  hex " << size << " bytes" << endl;
+    }
+}
+
+// Accepts plain byte counts and K/M/G suffixes (powers of 1024)
+bool parseSize(const string& text, size_t& size){
+    char* end = nullptr;
+    unsigned long long value = strtoull(text.c_str(), &end, 10);
+    if(end == text.c_str()) return false;
+    string suffix = end;
+    if(suffix == "K" || suffix == "k") value <<= 10;
+    else if(suffix == "M" || suffix == "m") value <<= 20;
+    else if(suffix == "G" || suffix == "g") value <<= 30;
+    else if(!suffix.empty()) return false;
+    size = (size_t)value;
+    return size > 0;
+}
+
+int main(int argc, char* argv[]){
+    BenchmarkSettings settings;
+    string backendName, outputName;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool ok = true;
+        if(arg == "--backend" && i + 1 < argc){
+            backendName = argv[++i];
+        } else if(arg == "--min-size" && i + 1 < argc){
+            ok = parseSize(argv[++i], settings.minSize);
+        } else if(arg == "--max-size" && i + 1 < argc){
+            ok = parseSize(argv[++i], settings.maxSize);
+        } else if(arg == "--min-time" && i + 1 < argc){
+            settings.minSeconds = atof(argv[++i]);
+        } else if(arg == "--threads" && i + 1 < argc){
+            settings.threads = (unsigned)atoi(argv[++i]);
+        } else if(arg == "--output" && i + 1 < argc){
+            outputName = argv[++i];
+        } else {
+            ok = false;
+        }
+        if(!ok){
+            cout << "Usage: " << argv[0] << " [--backend NAME|all] [--min-size N] [--max-size N] [--min-time SECONDS]"
+                 << " [--threads N] [--output FILE]" << endl;
+            cout << "Sizes accept K, M and G suffixes; the defaults sweep 8 to 1G." << endl;
+            return 1;
+        }
+    }
+    setSharedPoolThreads(settings.threads);
+
+    // Backends whose sized benchmarks run; the block primitives are backend-independent
+    vector<const BlockBackend*> backends;
+    if(backendName == "all"){
+        for(size_t i = 0; i < BLOCK_BACKEND_COUNT; i++){
+            if(BLOCK_BACKENDS[i].supported()) backends.push_back(&BLOCK_BACKENDS[i]);
+        }
+    } else if(!backendName.empty()){
+        if(!selectBackend(backendName)) return 1;
+        backends.push_back(&blockBackend());
+    } else {
+        backends.push_back(&blockBackend());
+    }
+
+    PerfCounters counters;
+    vector<BenchmarkResult> results;
+    cerr << "Block primitives" << endl;
+    benchmarkPrimitives(settings, counters, results);
+    for(const BlockBackend* backend : backends){
+        selectBackend(backend->name);
+        benchmarkText(settings, counters, results);
+        benchmarkBatch(settings, counters, results);
+    }
+    benchmarkHex(settings, counters, results);
+
+    ofstream file;
+    if(!outputName.empty()){
+        file.open(outputName, ios::trunc);
+        if(!file.is_open()){
+            cerr << "Error: Could not open " << outputName << " for writing." << endl;
+            return 1;
+        }
+    }
+    ostream& out = outputName.empty() ? cout : file;
+    const CpuFeatures& cpu = cpuFeatures();
+    out << setprecision(6);
+    out << "{\n  \"threads\": " << sharedPool().threadCount()
+        << ",\n  \"perf_counters\": " << (counters.available() ? "true" : "false")
+        << ",\n  \"cpu\": {\"sse2\": " << boolalpha << cpu.sse2 << ", \"avx2\": " << cpu.avx2
+        << ", \"avx512bw\": " << cpu.avx512bw << "},\n  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        writeResult(out, results[i]);
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}" << endl;
+    return 0;
+}
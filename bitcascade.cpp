@@ -0,0 +1,2043 @@
+#include "bitcascade.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <new>
+#include <sstream>
+#include <iomanip>
+using namespace std;
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BITCASCADE_X86 1
+// GCC 12's AVX-512 shift, broadcast and permute intrinsics start from _mm512_undefined_epi32(),
+// a self-initialized variable that -Wall reports as uninitialized wherever they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Lets a single function use a newer instruction set than the rest of the binary
+#if defined(__GNUC__)
+#define BITCASCADE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BITCASCADE_TARGET(isa)
+#endif
+
+unsigned char rotateLeft(unsigned char byte, int n){
+    return (byte << n) | (byte >> (8-n));
+}
+
+unsigned char rotateRight(unsigned char byte, int n){
+    return (byte >> n) | (byte << (8-n));
+}
+
+vector<unsigned char> generateSubkey(const string& key, int round){
+    vector<unsigned char> subkey;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        subkey.push_back((round + key[i % key.size()] + i * i) % 256);
+    }
+    return subkey;
+}
+
+KeySchedule::KeySchedule(const string& key, unsigned blockSize) : blockSize(blockSize) {
+    BITCASCADE_TIME_PHASE(PHASE_KEY_EXPANSION);
+    // The subkey of position i does not depend on the block size, so the 8-byte
+    // subkeys are the first columns of the wide ones
+    BitCascade<MAX_BLOCK_SIZE, TOTAL_ROUNDS>::expandKey(key, wideSubkeys);
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        subkeyWords[round] = 0;
+        for(int i = 0; i < BLOCK_SIZE; i++){
+            subkeys[round][i] = wideSubkeys[round][i];
+            subkeyWords[round] |= (uint64_t)subkeys[round][i] << (8 * i);
+        }
+    }
+}
+
+KeySchedule KeySchedule::withBlockSize(unsigned blockSize) const {
+    KeySchedule schedule(*this);
+    schedule.blockSize = blockSize;
+    return schedule;
+}
+
+uint64_t keyWord(const string& key){
+    uint64_t word = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        word |= (uint64_t)(unsigned char)key[i % key.size()] << (8 * i);
+    }
+    return word;
+}
+
+void confusion(vector<unsigned char> &block, const unsigned char (&subkey)[BLOCK_SIZE], int round){
+    for(int i = 0; i < block.size(); i++){
+        int tmp = ((block[i] ^ subkey[i % BLOCK_SIZE]) + i * i + round * 7);
+        block[i] = (tmp % 256 + 256) % 256;
+    }
+}
+
+void difusion(vector<unsigned char> &block){
+    for(int i = 0; i < block.size(); i++){
+        block[i] = rotateLeft(block[i], i + 1);
+    }
+
+    for(int i = 1; i < block.size(); i++){
+        block[i] ^= block[i - 1];
+    }
+
+    vector<unsigned char> temp(block.size());
+    for (int i = 0; i < block.size(); i++){
+        int j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
+        temp[j] = block[i];
+    }
+    block = temp;
+}
+
+void inverseDifusion(vector<unsigned char> &block){
+    vector<unsigned char> temp(block.size());
+    for (int i = 0; i < block.size(); i++){
+        int j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
+        temp[i] = block[j];
+    }
+
+    for(int i = temp.size() - 1; i >= 1; i--){
+        temp[i] ^= temp[i - 1];
+    }
+    
+    for(int i = 0; i < (int)temp.size(); i++){
+        temp[i] = rotateRight(temp[i], i + 1);
+    }
+    block = temp;
+}
+
+void inverseConfusion(vector<unsigned char> &block, const unsigned char (&subkey)[BLOCK_SIZE], int round){
+    for(int i = 0; i < block.size(); i++){
+        int tmp = (int)block[i] - (int)(i * i) - round * 7;
+        tmp = (tmp % 256 + 256) % 256;
+        block[i] = (unsigned char)(tmp ^ subkey[i % BLOCK_SIZE]);
+    }
+}
+
+vector<unsigned char> encryptBlock(vector<unsigned char> block, const KeySchedule &schedule){
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        confusion(block, schedule.subkeys[round], round);
+        difusion(block);
+    }
+    return block;
+}
+
+vector<unsigned char> decryptBlock(vector<unsigned char> block, const KeySchedule &schedule){
+    for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+        inverseDifusion(block);
+        inverseConfusion(block, schedule.subkeys[round], round);
+    }
+    return block;
+}
+
+// ===================== 64-BIT BLOCK ENGINE =====================
+// Same cipher as encryptBlock/decryptBlock, but the whole block lives in one
+// uint64_t (byte i = bits 8i..8i+7) and every step is a handful of word operations.
+
+constexpr uint64_t LANES_LOW = 0x0101010101010101ULL;
+constexpr uint64_t LANES_HIGH_BIT = 0x8080808080808080ULL;
+
+// Zig-zag transposition used by difusion: byte i moves to position zigzagIndex(i)
+constexpr int zigzagIndex(int i){
+    return (i % 2 == 0) ? (BLOCK_SIZE - 1 - i / 2) : (i / 2);
+}
+
+// The "i * i + round * 7" term of confusion for every byte of one round
+constexpr uint64_t roundOffsetWord(int round){
+    uint64_t word = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        word |= (uint64_t)((i * i + round * 7) & 0xFF) << (8 * i);
+    }
+    return word;
+}
+
+// Byte i is rotated left by (i + 1) in difusion (a rotation by 8 is a no-op).
+// Decryption rotates left by the complement instead of rotating right.
+constexpr int rotationAmount(int i, bool inverse){
+    return inverse ? (8 - ((i + 1) & 7)) & 7 : (i + 1) & 7;
+}
+
+// Bytes whose rotation amount has the given bit set
+constexpr uint64_t rotationMask(int bit, bool inverse){
+    uint64_t mask = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        if(rotationAmount(i, inverse) & (1 << bit)){
+            mask |= (uint64_t)0xFF << (8 * i);
+        }
+    }
+    return mask;
+}
+
+constexpr uint64_t ROUND_OFFSETS[TOTAL_ROUNDS] = {
+    roundOffsetWord(0), roundOffsetWord(1), roundOffsetWord(2), roundOffsetWord(3), roundOffsetWord(4)
+};
+
+inline uint64_t loadBlockWord(const unsigned char* bytes){
+    uint64_t word = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        word |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return word;
+}
+
+inline void storeBlockWord(uint64_t word, unsigned char* bytes){
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        bytes[i] = (unsigned char)(word >> (8 * i));
+    }
+}
+
+// Per-byte add/subtract without carries crossing byte boundaries
+inline uint64_t addBytes(uint64_t x, uint64_t y){
+    return ((x & ~LANES_HIGH_BIT) + (y & ~LANES_HIGH_BIT)) ^ ((x ^ y) & LANES_HIGH_BIT);
+}
+
+inline uint64_t subBytes(uint64_t x, uint64_t y){
+    return ((x | LANES_HIGH_BIT) - (y & ~LANES_HIGH_BIT)) ^ ((x ^ ~y) & LANES_HIGH_BIT);
+}
+
+// Rotates every byte left by S
+template <int S>
+inline uint64_t rotateBytesLeft(uint64_t x){
+    return ((x << S) & (LANES_LOW * ((0xFF << S) & 0xFF))) | ((x >> (8 - S)) & (LANES_LOW * ((1 << S) - 1)));
+}
+
+// Rotates each byte by its own amount: a rotation by 1, 2 and 4 applied only
+// to the bytes whose amount has that bit set
+template <bool Inverse>
+inline uint64_t rotateBytesVariable(uint64_t x){
+    constexpr uint64_t mask1 = rotationMask(0, Inverse);
+    constexpr uint64_t mask2 = rotationMask(1, Inverse);
+    constexpr uint64_t mask4 = rotationMask(2, Inverse);
+    x = (x & ~mask1) | (rotateBytesLeft<1>(x) & mask1);
+    x = (x & ~mask2) | (rotateBytesLeft<2>(x) & mask2);
+    x = (x & ~mask4) | (rotateBytesLeft<4>(x) & mask4);
+    return x;
+}
+
+inline uint64_t zigzagWord(uint64_t x){
+    uint64_t out = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        out |= ((x >> (8 * i)) & 0xFF) << (8 * zigzagIndex(i));
+    }
+    return out;
+}
+
+inline uint64_t inverseZigzagWord(uint64_t x){
+    uint64_t out = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        out |= ((x >> (8 * zigzagIndex(i))) & 0xFF) << (8 * i);
+    }
+    return out;
+}
+
+inline uint64_t encryptRoundWord(uint64_t x, uint64_t subkey, int round){
+    x = addBytes(x ^ subkey, ROUND_OFFSETS[round]);
+    x = rotateBytesVariable<false>(x);
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return zigzagWord(x);
+}
+
+inline uint64_t decryptRoundWord(uint64_t x, uint64_t subkey, int round){
+    x = inverseZigzagWord(x);
+    x ^= x << 8;
+    x = rotateBytesVariable<true>(x);
+    return subBytes(x, ROUND_OFFSETS[round]) ^ subkey;
+}
+
+uint64_t encryptBlockWord(uint64_t x, const KeySchedule &schedule){
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        x = encryptRoundWord(x, schedule.subkeyWords[round], round);
+    }
+    return x;
+}
+
+uint64_t decryptBlockWord(uint64_t x, const KeySchedule &schedule){
+    for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+        x = decryptRoundWord(x, schedule.subkeyWords[round], round);
+    }
+    return x;
+}
+
+// The "round + i * i" term of generateSubkey for every byte of one round
+constexpr uint64_t subkeyOffsetWord(int round){
+    uint64_t word = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        word |= (uint64_t)((round + i * i) & 0xFF) << (8 * i);
+    }
+    return word;
+}
+
+constexpr uint64_t SUBKEY_OFFSETS[TOTAL_ROUNDS] = {
+    subkeyOffsetWord(0), subkeyOffsetWord(1), subkeyOffsetWord(2), subkeyOffsetWord(3), subkeyOffsetWord(4)
+};
+
+void expandKeyWord(uint64_t keyWord, uint64_t (&subkeyWords)[TOTAL_ROUNDS]){
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        subkeyWords[round] = addBytes(keyWord, SUBKEY_OFFSETS[round]);
+    }
+}
+
+void encryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    for(size_t b = 0; b < blockCount; b++){
+        storeBlockWord(encryptBlockWord(loadBlockWord(in + b * BLOCK_SIZE), schedule), out + b * BLOCK_SIZE);
+    }
+}
+
+void decryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    for(size_t b = 0; b < blockCount; b++){
+        storeBlockWord(decryptBlockWord(loadBlockWord(in + b * BLOCK_SIZE), schedule), out + b * BLOCK_SIZE);
+    }
+}
+
+void encryptBlocksKeyed(const unsigned char* in, unsigned char* out, size_t blockCount,
+                        const uint64_t* const* blockKeys){
+    for(size_t b = 0; b < blockCount; b++){
+        uint64_t x = loadBlockWord(in + b * BLOCK_SIZE);
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            x = encryptRoundWord(x, blockKeys[b][round], round);
+        }
+        storeBlockWord(x, out + b * BLOCK_SIZE);
+    }
+}
+
+void decryptBlocksKeyed(const unsigned char* in, unsigned char* out, size_t blockCount,
+                        const uint64_t* const* blockKeys){
+    for(size_t b = 0; b < blockCount; b++){
+        uint64_t x = loadBlockWord(in + b * BLOCK_SIZE);
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            x = decryptRoundWord(x, blockKeys[b][round], round);
+        }
+        storeBlockWord(x, out + b * BLOCK_SIZE);
+    }
+}
+
+// ===================== TABLE BACKEND =====================
+// For a fixed key, confusion of byte i in round r followed by its rotation in
+// difusion is a bijection on 0..255. Both are fused into one 256-entry table per
+// (round, position), built once per key, so every byte costs one lookup per round.
+// The forward and inverse tables take 20 KB together and stay in L1.
+
+struct RoundTables {
+    uint64_t subkeyWords[TOTAL_ROUNDS]; // key the tables were built for
+    unsigned char forward[TOTAL_ROUNDS][BLOCK_SIZE][256];
+    unsigned char inverse[TOTAL_ROUNDS][BLOCK_SIZE][256];
+
+    void build(const KeySchedule &schedule){
+        memcpy(subkeyWords, schedule.subkeyWords, sizeof(subkeyWords));
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            for(int i = 0; i < BLOCK_SIZE; i++){
+                for(int b = 0; b < 256; b++){
+                    unsigned char confused = (unsigned char)((b ^ schedule.subkeys[round][i]) + i * i + round * 7);
+                    unsigned char rotated = rotateLeft(confused, i + 1);
+                    forward[round][i][b] = rotated;
+                    inverse[round][i][rotated] = (unsigned char)b;
+                }
+            }
+        }
+    }
+};
+
+// Tables for the given key, rebuilt only when the key changes. Each thread keeps its
+// own copy, so pool workers never share or lock them.
+const RoundTables& roundTables(const KeySchedule &schedule){
+    static thread_local unique_ptr<RoundTables> tables;
+    if(!tables){
+        tables = make_unique<RoundTables>();
+        tables->build(schedule);
+    } else if(memcmp(tables->subkeyWords, schedule.subkeyWords, sizeof(tables->subkeyWords)) != 0){
+        tables->build(schedule);
+    }
+    return *tables;
+}
+
+constexpr int inverseZigzagIndex(int j){
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        if(zigzagIndex(i) == j) return i;
+    }
+    return -1;
+}
+
+// Byte i of the result is table[i] applied to byte i of x. With Zigzagged, byte i is
+// read from (or written to) its zig-zag position instead, which folds the transposition
+// between two rounds into the lookups.
+template<bool ZigzaggedIn, bool ZigzaggedOut, size_t... I>
+inline uint64_t lookupBytes(uint64_t x, const unsigned char (&table)[BLOCK_SIZE][256], index_sequence<I...>){
+    return (((uint64_t)table[I][(x >> (8 * (ZigzaggedIn ? inverseZigzagIndex(I) : I))) & 0xFF]
+             << (8 * (ZigzaggedOut ? inverseZigzagIndex(I) : I))) | ...);
+}
+
+// Blocks in flight per iteration: independent lookup chains hide the load latency
+constexpr size_t TABLE_LANES = 4;
+
+void encryptBlocksTable(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    const RoundTables& tables = roundTables(schedule);
+    const auto bytes = make_index_sequence<BLOCK_SIZE>();
+    size_t b = 0;
+    for(; b + TABLE_LANES <= blockCount; b += TABLE_LANES){
+        uint64_t x[TABLE_LANES];
+        for(size_t k = 0; k < TABLE_LANES; k++){
+            x[k] = lookupBytes<false, false>(loadBlockWord(in + (b + k) * BLOCK_SIZE), tables.forward[0], bytes);
+            x[k] ^= x[k] << 8;
+            x[k] ^= x[k] << 16;
+            x[k] ^= x[k] << 32;
+        }
+        for(int round = 1; round < TOTAL_ROUNDS; round++){
+            for(size_t k = 0; k < TABLE_LANES; k++){
+                x[k] = lookupBytes<true, false>(x[k], tables.forward[round], bytes);
+                x[k] ^= x[k] << 8;
+                x[k] ^= x[k] << 16;
+                x[k] ^= x[k] << 32;
+            }
+        }
+        for(size_t k = 0; k < TABLE_LANES; k++){
+            storeBlockWord(zigzagWord(x[k]), out + (b + k) * BLOCK_SIZE);
+        }
+    }
+    encryptBlocks(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+void decryptBlocksTable(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    const RoundTables& tables = roundTables(schedule);
+    const auto bytes = make_index_sequence<BLOCK_SIZE>();
+    size_t b = 0;
+    for(; b + TABLE_LANES <= blockCount; b += TABLE_LANES){
+        uint64_t x[TABLE_LANES];
+        for(size_t k = 0; k < TABLE_LANES; k++){
+            x[k] = inverseZigzagWord(loadBlockWord(in + (b + k) * BLOCK_SIZE));
+        }
+        for(int round = TOTAL_ROUNDS-1; round > 0; round--){
+            for(size_t k = 0; k < TABLE_LANES; k++){
+                x[k] ^= x[k] << 8;
+                x[k] = lookupBytes<false, true>(x[k], tables.inverse[round], bytes);
+            }
+        }
+        for(size_t k = 0; k < TABLE_LANES; k++){
+            x[k] ^= x[k] << 8;
+            storeBlockWord(lookupBytes<false, false>(x[k], tables.inverse[0], bytes), out + (b + k) * BLOCK_SIZE);
+        }
+    }
+    decryptBlocks(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+// ===================== SIMD BLOCK KERNELS =====================
+// The 64-bit engine above uses only 64-bit shifts, masks and per-byte adds, so the
+// same steps run on every 64-bit lane of an SSE2/AVX2 register at once: 2 blocks
+// per XMM register and 4 per YMM register. Two registers are kept in flight per
+// iteration (4 blocks for SSE2, 8 for AVX2); leftover blocks use encryptBlocks.
+
+#ifdef BITCASCADE_X86
+
+// Byte shuffle for the zig-zag transposition of both 8-byte blocks in a 16-byte lane
+struct ZigzagShuffle {
+    char forward[16];
+    char inverse[16];
+};
+
+constexpr ZigzagShuffle makeZigzagShuffle(){
+    ZigzagShuffle shuffle = {};
+    for(int half = 0; half < 16; half += BLOCK_SIZE){
+        for(int i = 0; i < BLOCK_SIZE; i++){
+            shuffle.forward[half + zigzagIndex(i)] = (char)(half + i);
+            shuffle.inverse[half + i] = (char)(half + zigzagIndex(i));
+        }
+    }
+    return shuffle;
+}
+
+constexpr ZigzagShuffle ZIGZAG_SHUFFLE = makeZigzagShuffle();
+
+// ---- SSE2 ----
+
+template <int S>
+inline __m128i rotateBytesLeftSSE2(__m128i x){
+    const __m128i high = _mm_set1_epi8((char)((0xFF << S) & 0xFF));
+    const __m128i low = _mm_set1_epi8((char)((1 << S) - 1));
+    return _mm_or_si128(_mm_and_si128(_mm_slli_epi64(x, S), high), _mm_and_si128(_mm_srli_epi64(x, 8 - S), low));
+}
+
+template <bool Inverse>
+inline __m128i rotateBytesVariableSSE2(__m128i x){
+    const __m128i mask1 = _mm_set1_epi64x((long long)rotationMask(0, Inverse));
+    const __m128i mask2 = _mm_set1_epi64x((long long)rotationMask(1, Inverse));
+    const __m128i mask4 = _mm_set1_epi64x((long long)rotationMask(2, Inverse));
+    x = _mm_xor_si128(x, _mm_and_si128(_mm_xor_si128(x, rotateBytesLeftSSE2<1>(x)), mask1));
+    x = _mm_xor_si128(x, _mm_and_si128(_mm_xor_si128(x, rotateBytesLeftSSE2<2>(x)), mask2));
+    x = _mm_xor_si128(x, _mm_and_si128(_mm_xor_si128(x, rotateBytesLeftSSE2<4>(x)), mask4));
+    return x;
+}
+
+// SSE2 has no byte shuffle, so every byte is masked out and shifted to its new position
+template <int From, int To>
+inline __m128i moveByteSSE2(__m128i x){
+    const __m128i byte = _mm_and_si128(x, _mm_set1_epi64x((long long)((uint64_t)0xFF << (8 * From))));
+    if constexpr (To >= From){
+        return _mm_slli_epi64(byte, 8 * (To - From));
+    } else {
+        return _mm_srli_epi64(byte, 8 * (From - To));
+    }
+}
+
+template <size_t... I>
+inline __m128i zigzagSSE2(__m128i x, index_sequence<I...>){
+    __m128i out = _mm_setzero_si128();
+    ((out = _mm_or_si128(out, moveByteSSE2<I, zigzagIndex(I)>(x))), ...);
+    return out;
+}
+
+template <size_t... I>
+inline __m128i inverseZigzagSSE2(__m128i x, index_sequence<I...>){
+    __m128i out = _mm_setzero_si128();
+    ((out = _mm_or_si128(out, moveByteSSE2<zigzagIndex(I), I>(x))), ...);
+    return out;
+}
+
+inline __m128i encryptRoundSSE2(__m128i x, __m128i subkey, __m128i offset){
+    x = _mm_add_epi8(_mm_xor_si128(x, subkey), offset);
+    x = rotateBytesVariableSSE2<false>(x);
+    x = _mm_xor_si128(x, _mm_slli_epi64(x, 8));
+    x = _mm_xor_si128(x, _mm_slli_epi64(x, 16));
+    x = _mm_xor_si128(x, _mm_slli_epi64(x, 32));
+    return zigzagSSE2(x, make_index_sequence<BLOCK_SIZE>());
+}
+
+inline __m128i decryptRoundSSE2(__m128i x, __m128i subkey, __m128i offset){
+    x = inverseZigzagSSE2(x, make_index_sequence<BLOCK_SIZE>());
+    x = _mm_xor_si128(x, _mm_slli_epi64(x, 8));
+    x = rotateBytesVariableSSE2<true>(x);
+    return _mm_xor_si128(_mm_sub_epi8(x, offset), subkey);
+}
+
+void encryptBlocksSSE2(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    size_t b = 0;
+    for(; b + 4 <= blockCount; b += 4){
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE + 16));
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            const __m128i subkey = _mm_set1_epi64x((long long)schedule.subkeyWords[round]);
+            const __m128i offset = _mm_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = encryptRoundSSE2(x0, subkey, offset);
+            x1 = encryptRoundSSE2(x1, subkey, offset);
+        }
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE), x0);
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE + 16), x1);
+    }
+    encryptBlocks(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+void decryptBlocksSSE2(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    size_t b = 0;
+    for(; b + 4 <= blockCount; b += 4){
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE + 16));
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            const __m128i subkey = _mm_set1_epi64x((long long)schedule.subkeyWords[round]);
+            const __m128i offset = _mm_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = decryptRoundSSE2(x0, subkey, offset);
+            x1 = decryptRoundSSE2(x1, subkey, offset);
+        }
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE), x0);
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE + 16), x1);
+    }
+    decryptBlocks(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+// Multi-key variants: each 64-bit lane takes its own block's subkey word for the round.
+// Lane i holds subkey word [round] of block i.
+inline __m128i roundKeysSSE2(const uint64_t* const* keys, int round){
+    return _mm_set_epi64x((long long)keys[1][round], (long long)keys[0][round]);
+}
+
+void encryptBlocksKeyedSSE2(const unsigned char* in, unsigned char* out, size_t blockCount,
+                            const uint64_t* const* blockKeys){
+    size_t b = 0;
+    for(; b + 4 <= blockCount; b += 4){
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE + 16));
+        const uint64_t* const* keys = blockKeys + b;
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            const __m128i offset = _mm_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = encryptRoundSSE2(x0, roundKeysSSE2(keys, round), offset);
+            x1 = encryptRoundSSE2(x1, roundKeysSSE2(keys + 2, round), offset);
+        }
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE), x0);
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE + 16), x1);
+    }
+    encryptBlocksKeyed(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, blockKeys + b);
+}
+
+void decryptBlocksKeyedSSE2(const unsigned char* in, unsigned char* out, size_t blockCount,
+                            const uint64_t* const* blockKeys){
+    size_t b = 0;
+    for(; b + 4 <= blockCount; b += 4){
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(in + b * BLOCK_SIZE + 16));
+        const uint64_t* const* keys = blockKeys + b;
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            const __m128i offset = _mm_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = decryptRoundSSE2(x0, roundKeysSSE2(keys, round), offset);
+            x1 = decryptRoundSSE2(x1, roundKeysSSE2(keys + 2, round), offset);
+        }
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE), x0);
+        _mm_storeu_si128((__m128i*)(out + b * BLOCK_SIZE + 16), x1);
+    }
+    decryptBlocksKeyed(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, blockKeys + b);
+}
+
+// ---- AVX2 ----
+// Only call these after checking that the CPU supports AVX2.
+
+template <int S>
+BITCASCADE_TARGET("avx2") inline __m256i rotateBytesLeftAVX2(__m256i x){
+    const __m256i high = _mm256_set1_epi8((char)((0xFF << S) & 0xFF));
+    const __m256i low = _mm256_set1_epi8((char)((1 << S) - 1));
+    return _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(x, S), high), _mm256_and_si256(_mm256_srli_epi64(x, 8 - S), low));
+}
+
+template <bool Inverse>
+BITCASCADE_TARGET("avx2") inline __m256i rotateBytesVariableAVX2(__m256i x){
+    const __m256i mask1 = _mm256_set1_epi64x((long long)rotationMask(0, Inverse));
+    const __m256i mask2 = _mm256_set1_epi64x((long long)rotationMask(1, Inverse));
+    const __m256i mask4 = _mm256_set1_epi64x((long long)rotationMask(2, Inverse));
+    x = _mm256_blendv_epi8(x, rotateBytesLeftAVX2<1>(x), mask1);
+    x = _mm256_blendv_epi8(x, rotateBytesLeftAVX2<2>(x), mask2);
+    x = _mm256_blendv_epi8(x, rotateBytesLeftAVX2<4>(x), mask4);
+    return x;
+}
+
+BITCASCADE_TARGET("avx2") inline __m256i encryptRoundAVX2(__m256i x, __m256i subkey, __m256i offset, __m256i shuffle){
+    x = _mm256_add_epi8(_mm256_xor_si256(x, subkey), offset);
+    x = rotateBytesVariableAVX2<false>(x);
+    x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 8));
+    x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 16));
+    x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 32));
+    return _mm256_shuffle_epi8(x, shuffle);
+}
+
+BITCASCADE_TARGET("avx2") inline __m256i decryptRoundAVX2(__m256i x, __m256i subkey, __m256i offset, __m256i shuffle){
+    x = _mm256_shuffle_epi8(x, shuffle);
+    x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 8));
+    x = rotateBytesVariableAVX2<true>(x);
+    return _mm256_xor_si256(_mm256_sub_epi8(x, offset), subkey);
+}
+
+BITCASCADE_TARGET("avx2")
+void encryptBlocksAVX2(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.forward));
+    size_t b = 0;
+    for(; b + 8 <= blockCount; b += 8){
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE + 32));
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            const __m256i subkey = _mm256_set1_epi64x((long long)schedule.subkeyWords[round]);
+            const __m256i offset = _mm256_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = encryptRoundAVX2(x0, subkey, offset, shuffle);
+            x1 = encryptRoundAVX2(x1, subkey, offset, shuffle);
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE), x0);
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE + 32), x1);
+    }
+    encryptBlocks(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+BITCASCADE_TARGET("avx2")
+void decryptBlocksAVX2(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.inverse));
+    size_t b = 0;
+    for(; b + 8 <= blockCount; b += 8){
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE + 32));
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            const __m256i subkey = _mm256_set1_epi64x((long long)schedule.subkeyWords[round]);
+            const __m256i offset = _mm256_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = decryptRoundAVX2(x0, subkey, offset, shuffle);
+            x1 = decryptRoundAVX2(x1, subkey, offset, shuffle);
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE), x0);
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE + 32), x1);
+    }
+    decryptBlocks(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+BITCASCADE_TARGET("avx2") inline __m256i roundKeysAVX2(const uint64_t* const* keys, int round){
+    return _mm256_set_epi64x((long long)keys[3][round], (long long)keys[2][round],
+                             (long long)keys[1][round], (long long)keys[0][round]);
+}
+
+BITCASCADE_TARGET("avx2")
+void encryptBlocksKeyedAVX2(const unsigned char* in, unsigned char* out, size_t blockCount,
+                            const uint64_t* const* blockKeys){
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.forward));
+    size_t b = 0;
+    for(; b + 8 <= blockCount; b += 8){
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE + 32));
+        const uint64_t* const* keys = blockKeys + b;
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            const __m256i offset = _mm256_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = encryptRoundAVX2(x0, roundKeysAVX2(keys, round), offset, shuffle);
+            x1 = encryptRoundAVX2(x1, roundKeysAVX2(keys + 4, round), offset, shuffle);
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE), x0);
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE + 32), x1);
+    }
+    encryptBlocksKeyed(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, blockKeys + b);
+}
+
+BITCASCADE_TARGET("avx2")
+void decryptBlocksKeyedAVX2(const unsigned char* in, unsigned char* out, size_t blockCount,
+                            const uint64_t* const* blockKeys){
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.inverse));
+    size_t b = 0;
+    for(; b + 8 <= blockCount; b += 8){
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + b * BLOCK_SIZE + 32));
+        const uint64_t* const* keys = blockKeys + b;
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            const __m256i offset = _mm256_set1_epi64x((long long)ROUND_OFFSETS[round]);
+            x0 = decryptRoundAVX2(x0, roundKeysAVX2(keys, round), offset, shuffle);
+            x1 = decryptRoundAVX2(x1, roundKeysAVX2(keys + 4, round), offset, shuffle);
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE), x0);
+        _mm256_storeu_si256((__m256i*)(out + b * BLOCK_SIZE + 32), x1);
+    }
+    decryptBlocksKeyed(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, blockKeys + b);
+}
+
+// ---- AVX-512 (F + BW) ----
+// 8 blocks per ZMM register. Byte masks let the variable rotation use masked moves.
+
+constexpr uint64_t byteMaskBits(uint64_t laneMask){
+    uint64_t bits = 0;
+    for(int i = 0; i < 64; i++){
+        if((laneMask >> (8 * (i % BLOCK_SIZE))) & 0xFF){
+            bits |= (uint64_t)1 << i;
+        }
+    }
+    return bits;
+}
+
+template <int S>
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i rotateBytesLeftAVX512(__m512i x){
+    const __m512i high = _mm512_set1_epi8((char)((0xFF << S) & 0xFF));
+    return _mm512_ternarylogic_epi64(high, _mm512_slli_epi64(x, S), _mm512_srli_epi64(x, 8 - S), 0xCA);
+}
+
+template <bool Inverse>
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i rotateBytesVariableAVX512(__m512i x){
+    x = _mm512_mask_mov_epi8(x, byteMaskBits(rotationMask(0, Inverse)), rotateBytesLeftAVX512<1>(x));
+    x = _mm512_mask_mov_epi8(x, byteMaskBits(rotationMask(1, Inverse)), rotateBytesLeftAVX512<2>(x));
+    x = _mm512_mask_mov_epi8(x, byteMaskBits(rotationMask(2, Inverse)), rotateBytesLeftAVX512<4>(x));
+    return x;
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i encryptRoundAVX512(__m512i x, __m512i subkey, __m512i offset, __m512i shuffle){
+    x = _mm512_add_epi8(_mm512_xor_si512(x, subkey), offset);
+    x = rotateBytesVariableAVX512<false>(x);
+    x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 8));
+    x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 16));
+    x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 32));
+    return _mm512_shuffle_epi8(x, shuffle);
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i decryptRoundAVX512(__m512i x, __m512i subkey, __m512i offset, __m512i shuffle){
+    x = _mm512_shuffle_epi8(x, shuffle);
+    x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 8));
+    x = rotateBytesVariableAVX512<true>(x);
+    return _mm512_xor_si512(_mm512_sub_epi8(x, offset), subkey);
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw")
+void encryptBlocksAVX512(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.forward));
+    size_t b = 0;
+    for(; b + 16 <= blockCount; b += 16){
+        __m512i x0 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE));
+        __m512i x1 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE + 64));
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            const __m512i subkey = _mm512_set1_epi64((long long)schedule.subkeyWords[round]);
+            const __m512i offset = _mm512_set1_epi64((long long)ROUND_OFFSETS[round]);
+            x0 = encryptRoundAVX512(x0, subkey, offset, shuffle);
+            x1 = encryptRoundAVX512(x1, subkey, offset, shuffle);
+        }
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE), x0);
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE + 64), x1);
+    }
+    encryptBlocksAVX2(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw")
+void decryptBlocksAVX512(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.inverse));
+    size_t b = 0;
+    for(; b + 16 <= blockCount; b += 16){
+        __m512i x0 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE));
+        __m512i x1 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE + 64));
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            const __m512i subkey = _mm512_set1_epi64((long long)schedule.subkeyWords[round]);
+            const __m512i offset = _mm512_set1_epi64((long long)ROUND_OFFSETS[round]);
+            x0 = decryptRoundAVX512(x0, subkey, offset, shuffle);
+            x1 = decryptRoundAVX512(x1, subkey, offset, shuffle);
+        }
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE), x0);
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE + 64), x1);
+    }
+    decryptBlocksAVX2(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, schedule);
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i roundKeysAVX512(const uint64_t* const* keys, int round){
+    return _mm512_set_epi64((long long)keys[7][round], (long long)keys[6][round], (long long)keys[5][round],
+                            (long long)keys[4][round], (long long)keys[3][round], (long long)keys[2][round],
+                            (long long)keys[1][round], (long long)keys[0][round]);
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw")
+void encryptBlocksKeyedAVX512(const unsigned char* in, unsigned char* out, size_t blockCount,
+                              const uint64_t* const* blockKeys){
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.forward));
+    size_t b = 0;
+    for(; b + 16 <= blockCount; b += 16){
+        __m512i x0 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE));
+        __m512i x1 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE + 64));
+        const uint64_t* const* keys = blockKeys + b;
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            const __m512i offset = _mm512_set1_epi64((long long)ROUND_OFFSETS[round]);
+            x0 = encryptRoundAVX512(x0, roundKeysAVX512(keys, round), offset, shuffle);
+            x1 = encryptRoundAVX512(x1, roundKeysAVX512(keys + 8, round), offset, shuffle);
+        }
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE), x0);
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE + 64), x1);
+    }
+    encryptBlocksKeyedAVX2(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, blockKeys + b);
+}
+
+BITCASCADE_TARGET("avx512f,avx512bw")
+void decryptBlocksKeyedAVX512(const unsigned char* in, unsigned char* out, size_t blockCount,
+                              const uint64_t* const* blockKeys){
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE.inverse));
+    size_t b = 0;
+    for(; b + 16 <= blockCount; b += 16){
+        __m512i x0 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE));
+        __m512i x1 = _mm512_loadu_si512((const void*)(in + b * BLOCK_SIZE + 64));
+        const uint64_t* const* keys = blockKeys + b;
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            const __m512i offset = _mm512_set1_epi64((long long)ROUND_OFFSETS[round]);
+            x0 = decryptRoundAVX512(x0, roundKeysAVX512(keys, round), offset, shuffle);
+            x1 = decryptRoundAVX512(x1, roundKeysAVX512(keys + 8, round), offset, shuffle);
+        }
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE), x0);
+        _mm512_storeu_si512((void*)(out + b * BLOCK_SIZE + 64), x1);
+    }
+    decryptBlocksKeyedAVX2(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, blockCount - b, blockKeys + b);
+}
+
+#endif // BITCASCADE_X86
+
+// ===================== BACKEND DISPATCH =====================
+// Unsupported BITCASCADE_BACKEND or selectBackend() choices fall back to the best backend.
+
+CpuFeatures detectCpuFeatures(){
+    CpuFeatures features;
+#ifdef BITCASCADE_X86
+    unsigned int regs1[4] = {0, 0, 0, 0};
+    unsigned int regs7[4] = {0, 0, 0, 0};
+    unsigned long long xcr0 = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuidex(info, 1, 0);
+    for(int i = 0; i < 4; i++) regs1[i] = (unsigned int)info[i];
+    if(maxLeaf >= 7){
+        __cpuidex(info, 7, 0);
+        for(int i = 0; i < 4; i++) regs7[i] = (unsigned int)info[i];
+    }
+    bool osxsave = (regs1[2] >> 27) & 1;
+    if(osxsave) xcr0 = _xgetbv(0);
+#else
+    unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+    __get_cpuid(1, &regs1[0], &regs1[1], &regs1[2], &regs1[3]);
+    if(maxLeaf >= 7){
+        __cpuid_count(7, 0, regs7[0], regs7[1], regs7[2], regs7[3]);
+    }
+    bool osxsave = (regs1[2] >> 27) & 1;
+    if(osxsave){
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        xcr0 = ((unsigned long long)edx << 32) | eax;
+    }
+#endif
+    // The OS must also save the wider registers on context switches (XCR0)
+    bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+    bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+    features.sse2 = (regs1[3] >> 26) & 1;
+    features.avx2 = ymmEnabled && ((regs1[2] >> 28) & 1) && ((regs7[1] >> 5) & 1);
+    features.avx512bw = features.avx2 && zmmEnabled && ((regs7[1] >> 16) & 1) && ((regs7[1] >> 30) & 1);
+#endif
+    return features;
+}
+
+const CpuFeatures& cpuFeatures(){
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+// Compile-time unrolled backend (see bitcascade_block.h)
+void encryptBlocksUnrolled(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    StandardCascade::encryptBlocks(in, out, blockCount, schedule.subkeys);
+}
+
+void decryptBlocksUnrolled(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    StandardCascade::decryptBlocks(in, out, blockCount, schedule.subkeys);
+}
+
+// Wide-block variants run the unrolled template at their own size
+template<size_t WideSize>
+void encryptBlocksWide(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    typedef BitCascade<WideSize, TOTAL_ROUNDS> Cascade;
+    typename Cascade::Subkeys subkeys;
+    for(int round = 0; round < TOTAL_ROUNDS; round++) memcpy(subkeys[round], schedule.wideSubkeys[round], WideSize);
+    Cascade::encryptBlocks(in, out, blockCount, subkeys);
+}
+
+template<size_t WideSize>
+void decryptBlocksWide(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    typedef BitCascade<WideSize, TOTAL_ROUNDS> Cascade;
+    typename Cascade::Subkeys subkeys;
+    for(int round = 0; round < TOTAL_ROUNDS; round++) memcpy(subkeys[round], schedule.wideSubkeys[round], WideSize);
+    Cascade::decryptBlocks(in, out, blockCount, subkeys);
+}
+
+#ifdef BITCASCADE_X86
+// ---- Wide-block SIMD kernels ----
+// One 16-byte block per 128-bit lane, one 32-byte block per YMM, one 64-byte block per ZMM.
+// The rotation pattern repeats every 8 bytes, so the 8-byte rotation helpers apply
+// unchanged; the prefix XOR carry and the zig-zag have to cross 128-bit lanes.
+//
+// The zig-zag of any wide block is a per-lane shuffle (odd bytes to the low half, even
+// bytes reversed to the high half, i.e. the 16-byte zig-zag) followed by a reorder of
+// the 64-bit halves: 16 bytes {0,1}, 32 bytes {0,2,3,1}, 64 bytes {0,2,4,6,7,5,3,1}.
+
+struct WideLaneShuffle {
+    char forward[16];
+    char inverse[16];
+};
+
+constexpr WideLaneShuffle makeWideLaneShuffle(){
+    WideLaneShuffle shuffle = {};
+    for(size_t i = 0; i < 16; i++){
+        shuffle.forward[BitCascade<16, TOTAL_ROUNDS>::zigzag(i)] = (char)i;
+        shuffle.inverse[i] = (char)BitCascade<16, TOTAL_ROUNDS>::zigzag(i);
+    }
+    return shuffle;
+}
+
+constexpr WideLaneShuffle WIDE_LANE_SHUFFLE = makeWideLaneShuffle();
+
+struct WideOffsets {
+    unsigned char bytes[TOTAL_ROUNDS][MAX_BLOCK_SIZE];
+};
+
+constexpr WideOffsets makeWideOffsets(){
+    WideOffsets offsets = {};
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        for(size_t i = 0; i < MAX_BLOCK_SIZE; i++){
+            offsets.bytes[round][i] = BitCascade<MAX_BLOCK_SIZE, TOTAL_ROUNDS>::offset(round, i);
+        }
+    }
+    return offsets;
+}
+
+constexpr WideOffsets WIDE_OFFSETS = makeWideOffsets();
+
+// AVX2: 16-byte blocks two per register, 32-byte blocks one per register
+
+template<int WideSize>
+BITCASCADE_TARGET("avx2") inline __m256i loadWideRowAVX2(const unsigned char* row){
+    if(WideSize == 16) return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)row));
+    return _mm256_loadu_si256((const __m256i*)row);
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx2") inline __m256i encryptWideRoundAVX2(__m256i x, __m256i subkey, __m256i offset, __m256i shuffle){
+    x = _mm256_add_epi8(_mm256_xor_si256(x, subkey), offset);
+    x = rotateBytesVariableAVX2<false>(x);
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 1));
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 2));
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 4));
+    x = _mm256_xor_si256(x, _mm256_slli_si256(x, 8));
+    if(WideSize == 32){
+        // Carry the last byte of the low lane into every byte of the high lane
+        const __m256i last = _mm256_shuffle_epi8(x, _mm256_set1_epi8(15));
+        x = _mm256_xor_si256(x, _mm256_permute2x128_si256(last, last, 0x08));
+    }
+    x = _mm256_shuffle_epi8(x, shuffle);
+    if(WideSize == 32) x = _mm256_permute4x64_epi64(x, 0x78);
+    return x;
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx2") inline __m256i decryptWideRoundAVX2(__m256i x, __m256i subkey, __m256i offset, __m256i shuffle){
+    if(WideSize == 32) x = _mm256_permute4x64_epi64(x, 0x9C);
+    x = _mm256_shuffle_epi8(x, shuffle);
+    if(WideSize == 32){
+        x = _mm256_xor_si256(x, _mm256_alignr_epi8(x, _mm256_permute2x128_si256(x, x, 0x08), 15));
+    } else {
+        x = _mm256_xor_si256(x, _mm256_slli_si256(x, 1));
+    }
+    x = rotateBytesVariableAVX2<true>(x);
+    return _mm256_xor_si256(_mm256_sub_epi8(x, offset), subkey);
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx2")
+void encryptBlocksWideAVX2(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    constexpr size_t blocksPerStep = 64 / WideSize;
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)WIDE_LANE_SHUFFLE.forward));
+    __m256i subkeys[TOTAL_ROUNDS], offsets[TOTAL_ROUNDS];
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        subkeys[round] = loadWideRowAVX2<WideSize>(schedule.wideSubkeys[round]);
+        offsets[round] = loadWideRowAVX2<WideSize>(WIDE_OFFSETS.bytes[round]);
+    }
+    size_t b = 0;
+    for(; b + blocksPerStep <= blockCount; b += blocksPerStep){
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + b * WideSize));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + b * WideSize + 32));
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            x0 = encryptWideRoundAVX2<WideSize>(x0, subkeys[round], offsets[round], shuffle);
+            x1 = encryptWideRoundAVX2<WideSize>(x1, subkeys[round], offsets[round], shuffle);
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * WideSize), x0);
+        _mm256_storeu_si256((__m256i*)(out + b * WideSize + 32), x1);
+    }
+    encryptBlocksWide<WideSize>(in + b * WideSize, out + b * WideSize, blockCount - b, schedule);
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx2")
+void decryptBlocksWideAVX2(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    constexpr size_t blocksPerStep = 64 / WideSize;
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)WIDE_LANE_SHUFFLE.inverse));
+    __m256i subkeys[TOTAL_ROUNDS], offsets[TOTAL_ROUNDS];
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        subkeys[round] = loadWideRowAVX2<WideSize>(schedule.wideSubkeys[round]);
+        offsets[round] = loadWideRowAVX2<WideSize>(WIDE_OFFSETS.bytes[round]);
+    }
+    size_t b = 0;
+    for(; b + blocksPerStep <= blockCount; b += blocksPerStep){
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + b * WideSize));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + b * WideSize + 32));
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            x0 = decryptWideRoundAVX2<WideSize>(x0, subkeys[round], offsets[round], shuffle);
+            x1 = decryptWideRoundAVX2<WideSize>(x1, subkeys[round], offsets[round], shuffle);
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * WideSize), x0);
+        _mm256_storeu_si256((__m256i*)(out + b * WideSize + 32), x1);
+    }
+    decryptBlocksWide<WideSize>(in + b * WideSize, out + b * WideSize, blockCount - b, schedule);
+}
+
+// AVX-512: 16-byte blocks four per register, 32-byte blocks two, 64-byte blocks one
+
+template<int WideSize>
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i loadWideRowAVX512(const unsigned char* row){
+    if(WideSize == 16) return _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)row));
+    if(WideSize == 32) return _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i*)row));
+    return _mm512_loadu_si512((const void*)row);
+}
+
+// Moves every 128-bit lane up by Lanes (lanes shifted in from below are zero)
+template<int Lanes>
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i shiftLanesUpAVX512(__m512i x){
+    return _mm512_alignr_epi64(x, _mm512_setzero_si512(), 8 - 2 * Lanes);
+}
+
+// Every odd 128-bit lane gets a copy of the lane below it, even lanes are zero (32-byte blocks)
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i lowerLaneIntoUpperAVX512(__m512i x){
+    return _mm512_maskz_shuffle_i64x2(0xCC, x, x, 0xA0);
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i encryptWideRoundAVX512(__m512i x, __m512i subkey, __m512i offset, __m512i shuffle){
+    x = _mm512_add_epi8(_mm512_xor_si512(x, subkey), offset);
+    x = rotateBytesVariableAVX512<false>(x);
+    x = _mm512_xor_si512(x, _mm512_bslli_epi128(x, 1));
+    x = _mm512_xor_si512(x, _mm512_bslli_epi128(x, 2));
+    x = _mm512_xor_si512(x, _mm512_bslli_epi128(x, 4));
+    x = _mm512_xor_si512(x, _mm512_bslli_epi128(x, 8));
+    if(WideSize == 32){
+        x = _mm512_xor_si512(x, lowerLaneIntoUpperAVX512(_mm512_shuffle_epi8(x, _mm512_set1_epi8(15))));
+    } else if(WideSize == 64){
+        // Exclusive prefix XOR of the lane totals, in two doubling steps
+        __m512i carry = _mm512_shuffle_epi8(x, _mm512_set1_epi8(15));
+        carry = _mm512_xor_si512(carry, shiftLanesUpAVX512<1>(carry));
+        carry = _mm512_xor_si512(carry, shiftLanesUpAVX512<2>(carry));
+        x = _mm512_xor_si512(x, shiftLanesUpAVX512<1>(carry));
+    }
+    x = _mm512_shuffle_epi8(x, shuffle);
+    if(WideSize == 32) x = _mm512_permutex_epi64(x, 0x78);
+    if(WideSize == 64) x = _mm512_permutexvar_epi64(_mm512_set_epi64(1, 3, 5, 7, 6, 4, 2, 0), x);
+    return x;
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx512f,avx512bw") inline __m512i decryptWideRoundAVX512(__m512i x, __m512i subkey, __m512i offset, __m512i shuffle){
+    if(WideSize == 32) x = _mm512_permutex_epi64(x, 0x9C);
+    if(WideSize == 64) x = _mm512_permutexvar_epi64(_mm512_set_epi64(4, 3, 5, 2, 6, 1, 7, 0), x);
+    x = _mm512_shuffle_epi8(x, shuffle);
+    if(WideSize == 32){
+        x = _mm512_xor_si512(x, _mm512_alignr_epi8(x, lowerLaneIntoUpperAVX512(x), 15));
+    } else if(WideSize == 64){
+        x = _mm512_xor_si512(x, _mm512_alignr_epi8(x, shiftLanesUpAVX512<1>(x), 15));
+    } else {
+        x = _mm512_xor_si512(x, _mm512_bslli_epi128(x, 1));
+    }
+    x = rotateBytesVariableAVX512<true>(x);
+    return _mm512_xor_si512(_mm512_sub_epi8(x, offset), subkey);
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx512f,avx512bw")
+void encryptBlocksWideAVX512(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    constexpr size_t blocksPerStep = 128 / WideSize;
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)WIDE_LANE_SHUFFLE.forward));
+    __m512i subkeys[TOTAL_ROUNDS], offsets[TOTAL_ROUNDS];
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        subkeys[round] = loadWideRowAVX512<WideSize>(schedule.wideSubkeys[round]);
+        offsets[round] = loadWideRowAVX512<WideSize>(WIDE_OFFSETS.bytes[round]);
+    }
+    size_t b = 0;
+    for(; b + blocksPerStep <= blockCount; b += blocksPerStep){
+        __m512i x0 = _mm512_loadu_si512((const void*)(in + b * WideSize));
+        __m512i x1 = _mm512_loadu_si512((const void*)(in + b * WideSize + 64));
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            x0 = encryptWideRoundAVX512<WideSize>(x0, subkeys[round], offsets[round], shuffle);
+            x1 = encryptWideRoundAVX512<WideSize>(x1, subkeys[round], offsets[round], shuffle);
+        }
+        _mm512_storeu_si512((void*)(out + b * WideSize), x0);
+        _mm512_storeu_si512((void*)(out + b * WideSize + 64), x1);
+    }
+    if(WideSize == 64){
+        encryptBlocksWide<WideSize>(in + b * WideSize, out + b * WideSize, blockCount - b, schedule);
+    } else {
+        encryptBlocksWideAVX2<WideSize>(in + b * WideSize, out + b * WideSize, blockCount - b, schedule);
+    }
+}
+
+template<int WideSize>
+BITCASCADE_TARGET("avx512f,avx512bw")
+void decryptBlocksWideAVX512(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    constexpr size_t blocksPerStep = 128 / WideSize;
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)WIDE_LANE_SHUFFLE.inverse));
+    __m512i subkeys[TOTAL_ROUNDS], offsets[TOTAL_ROUNDS];
+    for(int round = 0; round < TOTAL_ROUNDS; round++){
+        subkeys[round] = loadWideRowAVX512<WideSize>(schedule.wideSubkeys[round]);
+        offsets[round] = loadWideRowAVX512<WideSize>(WIDE_OFFSETS.bytes[round]);
+    }
+    size_t b = 0;
+    for(; b + blocksPerStep <= blockCount; b += blocksPerStep){
+        __m512i x0 = _mm512_loadu_si512((const void*)(in + b * WideSize));
+        __m512i x1 = _mm512_loadu_si512((const void*)(in + b * WideSize + 64));
+        for(int round = TOTAL_ROUNDS-1; round >= 0; round--){
+            x0 = decryptWideRoundAVX512<WideSize>(x0, subkeys[round], offsets[round], shuffle);
+            x1 = decryptWideRoundAVX512<WideSize>(x1, subkeys[round], offsets[round], shuffle);
+        }
+        _mm512_storeu_si512((void*)(out + b * WideSize), x0);
+        _mm512_storeu_si512((void*)(out + b * WideSize + 64), x1);
+    }
+    if(WideSize == 64){
+        decryptBlocksWide<WideSize>(in + b * WideSize, out + b * WideSize, blockCount - b, schedule);
+    } else {
+        decryptBlocksWideAVX2<WideSize>(in + b * WideSize, out + b * WideSize, blockCount - b, schedule);
+    }
+}
+#endif // BITCASCADE_X86
+
+// Reference backend: the original byte-wise encryptBlock/decryptBlock, one block at a time
+void encryptBlocksReference(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    for(size_t b = 0; b < blockCount; b++){
+        vector<unsigned char> block(in + b * BLOCK_SIZE, in + (b + 1) * BLOCK_SIZE);
+        block = encryptBlock(block, schedule);
+        copy(block.begin(), block.end(), out + b * BLOCK_SIZE);
+    }
+}
+
+void decryptBlocksReference(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule){
+    for(size_t b = 0; b < blockCount; b++){
+        vector<unsigned char> block(in + b * BLOCK_SIZE, in + (b + 1) * BLOCK_SIZE);
+        block = decryptBlock(block, schedule);
+        copy(block.begin(), block.end(), out + b * BLOCK_SIZE);
+    }
+}
+
+bool alwaysSupported(){ return true; }
+#ifdef BITCASCADE_X86
+bool sse2Supported(){ return cpuFeatures().sse2; }
+bool avx2Supported(){ return cpuFeatures().avx2; }
+bool avx512Supported(){ return cpuFeatures().avx512bw; }
+#endif
+
+// Fastest first; the last entry is always usable
+const BlockBackend BLOCK_BACKENDS[] = {
+#ifdef BITCASCADE_X86
+    {"avx512", encryptBlocksAVX512, decryptBlocksAVX512, avx512Supported},
+    {"avx2", encryptBlocksAVX2, decryptBlocksAVX2, avx2Supported},
+    {"sse2", encryptBlocksSSE2, decryptBlocksSSE2, sse2Supported},
+#endif
+    {"unrolled", encryptBlocksUnrolled, decryptBlocksUnrolled, alwaysSupported},
+    {"table", encryptBlocksTable, decryptBlocksTable, alwaysSupported},
+    {"word", encryptBlocks, decryptBlocks, alwaysSupported},
+    {"scalar", encryptBlocksReference, decryptBlocksReference, alwaysSupported},
+};
+
+const size_t BLOCK_BACKEND_COUNT = sizeof(BLOCK_BACKENDS) / sizeof(BLOCK_BACKENDS[0]);
+
+const BlockBackend* findBackend(const string& name){
+    for(const BlockBackend& backend : BLOCK_BACKENDS){
+        if(name == backend.name) return &backend;
+    }
+    return nullptr;
+}
+
+const BlockBackend* bestBackend(){
+    for(const BlockBackend& backend : BLOCK_BACKENDS){
+        if(backend.supported()) return &backend;
+    }
+    return &BLOCK_BACKENDS[0];
+}
+
+// Looks up a usable backend by name, or returns nullptr with a message
+const BlockBackend* usableBackend(const string& name){
+    const BlockBackend* backend = findBackend(name);
+    if(!backend){
+        cout << "Warning: unknown backend \"" << name << "\"." << endl;
+        return nullptr;
+    }
+    if(!backend->supported()){
+        cout << "Warning: backend \"" << name << "\" is not supported by this CPU." << endl;
+        return nullptr;
+    }
+    return backend;
+}
+
+const BlockBackend*& backendSlot(){
+    static const BlockBackend* slot = []{
+        const char* forced = getenv("BITCASCADE_BACKEND");
+        const BlockBackend* backend = (forced && *forced) ? usableBackend(forced) : nullptr;
+        return backend ? backend : bestBackend();
+    }();
+    return slot;
+}
+
+const BlockBackend& blockBackend(){
+    return *backendSlot();
+}
+
+BlockVariant blockVariant(const KeySchedule& schedule){
+#ifdef BITCASCADE_X86
+    // Wide blocks use the SIMD kernels of the selected backend's instruction set
+    const BlockBackend& backend = blockBackend();
+    if(backend.encrypt == encryptBlocksAVX512){
+        switch(schedule.blockSize){
+            case 16: return {16, encryptBlocksWideAVX512<16>, decryptBlocksWideAVX512<16>};
+            case 32: return {32, encryptBlocksWideAVX512<32>, decryptBlocksWideAVX512<32>};
+            case 64: return {64, encryptBlocksWideAVX512<64>, decryptBlocksWideAVX512<64>};
+        }
+    } else if(backend.encrypt == encryptBlocksAVX2){
+        switch(schedule.blockSize){
+            case 16: return {16, encryptBlocksWideAVX2<16>, decryptBlocksWideAVX2<16>};
+            case 32: return {32, encryptBlocksWideAVX2<32>, decryptBlocksWideAVX2<32>};
+        }
+    }
+#endif
+    switch(schedule.blockSize){
+        case 16: return {16, encryptBlocksWide<16>, decryptBlocksWide<16>};
+        case 32: return {32, encryptBlocksWide<32>, decryptBlocksWide<32>};
+        case 64: return {64, encryptBlocksWide<64>, decryptBlocksWide<64>};
+        default: return {BLOCK_SIZE, blockBackend().encrypt, blockBackend().decrypt};
+    }
+}
+
+KeyedBlockVariant keyedBlockVariant(){
+#ifdef BITCASCADE_X86
+    const BlockBackend& backend = blockBackend();
+    if(backend.encrypt == encryptBlocksAVX512) return {encryptBlocksKeyedAVX512, decryptBlocksKeyedAVX512};
+    if(backend.encrypt == encryptBlocksAVX2) return {encryptBlocksKeyedAVX2, decryptBlocksKeyedAVX2};
+    if(backend.encrypt == encryptBlocksSSE2) return {encryptBlocksKeyedSSE2, decryptBlocksKeyedSSE2};
+#endif
+    return {encryptBlocksKeyed, decryptBlocksKeyed};
+}
+
+bool selectBackend(const string& name){
+    const BlockBackend* backend = usableBackend(name);
+    if(!backend) return false;
+    backendSlot() = backend;
+    return true;
+}
+
+// ===================== KEY SCHEDULE CACHE =====================
+
+struct KeyScheduleCache::Shard {
+    typedef pair<string, unsigned> CacheKey;
+    struct CacheKeyHash {
+        size_t operator()(const CacheKey& key) const { return hash<string>()(key.first) * 31 + key.second; }
+    };
+    typedef list<pair<CacheKey, shared_ptr<const KeySchedule>>> Entries;
+
+    mutable mutex lock;
+    Entries entries; // most recently used first
+    unordered_map<CacheKey, Entries::iterator, CacheKeyHash> index;
+    Counters counters;
+};
+
+KeyScheduleCache::KeyScheduleCache(size_t capacity, size_t shardCount){
+    shardCount = max<size_t>(1, shardCount);
+    shardCapacity = max<size_t>(1, (capacity + shardCount - 1) / shardCount);
+    for(size_t i = 0; i < shardCount; i++){
+        shards.push_back(make_unique<Shard>());
+    }
+}
+
+KeyScheduleCache::~KeyScheduleCache() = default;
+
+KeyScheduleCache::Shard& KeyScheduleCache::shardFor(size_t hash) const {
+    return *shards[hash % shards.size()];
+}
+
+shared_ptr<const KeySchedule> KeyScheduleCache::get(const string& key, unsigned blockSize){
+    Shard::CacheKey cacheKey(key, blockSize);
+    Shard& shard = shardFor(Shard::CacheKeyHash()(cacheKey));
+    {
+        lock_guard<mutex> lock(shard.lock);
+        auto found = shard.index.find(cacheKey);
+        if(found != shard.index.end()){
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            shard.counters.hits++;
+            return found->second->second;
+        }
+        shard.counters.misses++;
+    }
+    
+    // Expanded outside the lock; another thread may have inserted the same key meanwhile
+    shared_ptr<const KeySchedule> schedule = make_shared<const KeySchedule>(key, blockSize);
+    lock_guard<mutex> lock(shard.lock);
+    auto found = shard.index.find(cacheKey);
+    if(found != shard.index.end()) return found->second->second;
+    shard.entries.emplace_front(cacheKey, schedule);
+    shard.index.emplace(move(cacheKey), shard.entries.begin());
+    if(shard.entries.size() > shardCapacity){
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+        shard.counters.evictions++;
+    }
+    return schedule;
+}
+
+KeyScheduleCache::Counters KeyScheduleCache::counters() const {
+    Counters total;
+    for(const auto& shard : shards){
+        lock_guard<mutex> lock(shard->lock);
+        total.hits += shard->counters.hits;
+        total.misses += shard->counters.misses;
+        total.evictions += shard->counters.evictions;
+    }
+    return total;
+}
+
+size_t KeyScheduleCache::size() const {
+    size_t total = 0;
+    for(const auto& shard : shards){
+        lock_guard<mutex> lock(shard->lock);
+        total += shard->entries.size();
+    }
+    return total;
+}
+
+void KeyScheduleCache::clear(){
+    for(const auto& shard : shards){
+        lock_guard<mutex> lock(shard->lock);
+        shard->index.clear();
+        shard->entries.clear();
+    }
+}
+
+KeyScheduleCache& sharedKeyCache(){
+    static KeyScheduleCache cache;
+    return cache;
+}
+
+// ===================== PARALLEL BULK ENCRYPTION =====================
+
+namespace {
+thread_local bool runningPoolTask = false;
+unsigned configuredThreadCount = 0; // 0 = all hardware threads
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount){
+    if(threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+    for(unsigned i = 0; i < threadCount; i++){
+        queues.push_back(make_unique<WorkerQueue>());
+    }
+    for(unsigned i = 1; i < threadCount; i++){
+        workers.emplace_back([this, i]{ workerLoop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool(){
+    {
+        lock_guard<mutex> lock(stateLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for(thread& worker : workers) worker.join();
+}
+
+bool WorkStealingPool::insideTask(){
+    return runningPoolTask;
+}
+
+void WorkStealingPool::parallelFor(size_t taskCount, const function<void(size_t)>& task){
+    if(taskCount == 0) return;
+    lock_guard<mutex> submit(submitLock);
+    {
+        lock_guard<mutex> lock(stateLock);
+        currentTask = &task;
+        pending = taskCount;
+        firstError = nullptr;
+        // Contiguous ranges keep each thread streaming through memory until it has to steal
+        size_t perQueue = (taskCount + queues.size() - 1) / queues.size();
+        for(size_t q = 0; q < queues.size(); q++){
+            lock_guard<mutex> queueLock(queues[q]->lock);
+            for(size_t i = q * perQueue; i < min(taskCount, (q + 1) * perQueue); i++){
+                queues[q]->tasks.push_back(i);
+            }
+        }
+        generation++;
+    }
+    wakeUp.notify_all();
+
+    runTasks(0);
+
+    unique_lock<mutex> lock(stateLock);
+    allDone.wait(lock, [this]{ return pending == 0; });
+    currentTask = nullptr;
+    if(firstError) rethrow_exception(firstError);
+}
+
+bool WorkStealingPool::popOwn(size_t self, size_t& index){
+    WorkerQueue& queue = *queues[self];
+    lock_guard<mutex> lock(queue.lock);
+    if(queue.tasks.empty()) return false;
+    index = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t self, size_t& index){
+    for(size_t offset = 1; offset < queues.size(); offset++){
+        WorkerQueue& victim = *queues[(self + offset) % queues.size()];
+        lock_guard<mutex> lock(victim.lock);
+        if(!victim.tasks.empty()){
+            index = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::runTasks(size_t self){
+    size_t index;
+    while(popOwn(self, index) || steal(self, index)){
+        runningPoolTask = true;
+        try {
+            (*currentTask)(index);
+        } catch (...) {
+            lock_guard<mutex> lock(stateLock);
+            if(!firstError) firstError = current_exception();
+        }
+        runningPoolTask = false;
+        lock_guard<mutex> lock(stateLock);
+        if(--pending == 0) allDone.notify_all();
+    }
+}
+
+void WorkStealingPool::workerLoop(size_t self){
+    unsigned long long seen = 0;
+    while(true){
+        {
+            unique_lock<mutex> lock(stateLock);
+            wakeUp.wait(lock, [&]{ return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+        }
+        runTasks(self);
+    }
+}
+
+void setSharedPoolThreads(unsigned threadCount){
+    configuredThreadCount = threadCount;
+}
+
+unsigned sharedPoolThreads(){
+    return configuredThreadCount;
+}
+
+WorkStealingPool& sharedPool(){
+    static WorkStealingPool pool(configuredThreadCount);
+    return pool;
+}
+
+// Runs the schedule's kernels over blockCount blocks, one chunk per pool task
+void parallelBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule,
+                    bool encrypt, WorkStealingPool& pool){
+    BlockVariant variant = blockVariant(schedule);
+    BlockFunction kernel = encrypt ? variant.encrypt : variant.decrypt;
+    const size_t blockSize = variant.blockSize;
+    const size_t chunkBlocks = PARALLEL_CHUNK_BYTES / blockSize;
+    size_t chunkCount = (blockCount + chunkBlocks - 1) / chunkBlocks;
+    if(chunkCount <= 1 || pool.threadCount() == 1 || WorkStealingPool::insideTask()){
+        kernel(in, out, blockCount, schedule);
+        return;
+    }
+    pool.parallelFor(chunkCount, [&](size_t chunk){
+        size_t first = chunk * chunkBlocks;
+        size_t count = min(chunkBlocks, blockCount - first);
+        kernel(in + first * blockSize, out + first * blockSize, count, schedule);
+    });
+}
+
+void parallelEncryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule,
+                           WorkStealingPool& pool){
+    BITCASCADE_TIME_PHASE(PHASE_ENCRYPT_BLOCKS);
+    BITCASCADE_ADD_BYTES(PHASE_ENCRYPT_BLOCKS, (uint64_t)blockCount * schedule.blockSize);
+    parallelBlocks(in, out, blockCount, schedule, true, pool);
+}
+
+void parallelDecryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule &schedule,
+                           WorkStealingPool& pool){
+    BITCASCADE_TIME_PHASE(PHASE_DECRYPT_BLOCKS);
+    BITCASCADE_ADD_BYTES(PHASE_DECRYPT_BLOCKS, (uint64_t)blockCount * schedule.blockSize);
+    parallelBlocks(in, out, blockCount, schedule, false, pool);
+}
+
+// ===================== SPAN API =====================
+
+size_t encryptInto(Span<const uint8_t> in, Span<uint8_t> out, const KeySchedule& schedule){
+    BlockVariant variant = blockVariant(schedule);
+    const size_t blockSize = variant.blockSize;
+    size_t fullBlocks = in.size() / blockSize;
+    size_t leftover = in.size() % blockSize;
+    if(out.size() < encryptedSize(in.size(), blockSize)) return 0;
+    
+    // The tail is copied out first, since out may overwrite in
+    unsigned char tail[MAX_BLOCK_SIZE];
+    if(leftover > 0) memcpy(tail, in.data() + fullBlocks * blockSize, leftover);
+    memset(tail + leftover, (int)(blockSize - leftover), blockSize - leftover);
+    
+    parallelEncryptBlocks(in.data(), out.data(), fullBlocks, schedule);
+    variant.encrypt(tail, out.data() + fullBlocks * blockSize, 1, schedule);
+    return (fullBlocks + 1) * blockSize;
+}
+
+size_t decryptInto(Span<const uint8_t> in, Span<uint8_t> out, const KeySchedule& schedule, bool& validKey){
+    validKey = false;
+    BlockVariant variant = blockVariant(schedule);
+    const size_t blockSize = variant.blockSize;
+    // Ciphertext is always whole blocks; anything else is corrupted
+    if(in.empty() || in.size() % blockSize != 0 || out.size() < in.size() - 1) return 0;
+    
+    size_t fullBlocks = in.size() / blockSize - 1;
+    unsigned char tail[MAX_BLOCK_SIZE];
+    variant.decrypt(in.data() + fullBlocks * blockSize, tail, 1, schedule);
+    
+    size_t padding = paddingLength(tail, blockSize);
+    if(padding == 0) return 0;
+    validKey = true;
+    
+    parallelDecryptBlocks(in.data(), out.data(), fullBlocks, schedule);
+    memcpy(out.data() + fullBlocks * blockSize, tail, blockSize - padding);
+    return in.size() - padding;
+}
+
+size_t paddingLength(const unsigned char* tail, size_t blockSize){
+    BITCASCADE_TIME_PHASE(PHASE_PADDING_CHECK);
+    unsigned char padding = tail[blockSize - 1];
+    if(padding == 0 || padding > blockSize) return 0;
+    for(size_t i = blockSize - padding; i < blockSize; i++){
+        if(tail[i] != padding) return 0;
+    }
+    return padding;
+}
+
+size_t checkTailBlock(Span<const uint8_t> encrypted, const KeySchedule& schedule, bool& validKey){
+    validKey = false;
+    BlockVariant variant = blockVariant(schedule);
+    const size_t blockSize = variant.blockSize;
+    if(encrypted.empty() || encrypted.size() % blockSize != 0) return 0;
+    
+    unsigned char tail[MAX_BLOCK_SIZE];
+    variant.decrypt(encrypted.data() + encrypted.size() - blockSize, tail, 1, schedule);
+    size_t padding = paddingLength(tail, blockSize);
+    if(padding == 0) return 0;
+    validKey = true;
+    return encrypted.size() - padding;
+}
+
+vector<unsigned char> encryptText(const string& text, const KeySchedule& schedule){
+    vector<unsigned char> encrypted(encryptedSize(text.size(), schedule.blockSize));
+    encryptInto(Span<const uint8_t>((const uint8_t*)text.data(), text.size()), encrypted, schedule);
+    return encrypted;
+}
+
+string decryptText(const vector<unsigned char>& encrypted, const KeySchedule& schedule, bool& validKey) {
+    // The tail is checked before the output is allocated, so a wrong key costs one block
+    checkTailBlock(encrypted, schedule, validKey);
+    if(!validKey) return string();
+    string decrypted(encrypted.size() - 1, '\0');
+    size_t length = decryptInto(encrypted, Span<uint8_t>((uint8_t*)&decrypted[0], decrypted.size()), schedule, validKey);
+    decrypted.resize(length);
+    return decrypted;
+}
+
+// ===================== BATCH API =====================
+
+namespace {
+// Blocks packed per pass: the data and key pointers of one pass stay in L1/L2
+constexpr size_t BATCH_GROUP_BLOCKS = 2048;
+
+struct BatchBuffers {
+    vector<unsigned char> blocks;
+    vector<const uint64_t*> blockKeys;
+};
+
+size_t packedBlocks(const BatchMessage& message, bool encrypt){
+    return encrypt ? message.in.size() / BLOCK_SIZE + 1 : message.in.size() / BLOCK_SIZE;
+}
+
+// Gathers the messages into one buffer, runs the kernel once, and scatters the results
+void runBatchGroup(BatchMessage* messages, const size_t* indices, size_t count, size_t blockCount, bool encrypt){
+    thread_local BatchBuffers buffers;
+    buffers.blocks.resize(blockCount * BLOCK_SIZE);
+    buffers.blockKeys.resize(blockCount);
+    unsigned char* packed = buffers.blocks.data();
+    const uint64_t** blockKeys = buffers.blockKeys.data();
+
+    size_t b = 0;
+    for(size_t i = 0; i < count; i++){
+        const BatchMessage& message = messages[indices[i]];
+        size_t blocks = packedBlocks(message, encrypt);
+        unsigned char* first = packed + b * BLOCK_SIZE;
+        if(!message.in.empty()) memcpy(first, message.in.data(), message.in.size());
+        if(encrypt){
+            size_t padding = blocks * BLOCK_SIZE - message.in.size();
+            memset(first + message.in.size(), (int)padding, padding);
+        }
+        fill_n(blockKeys + b, blocks, message.schedule->subkeyWords);
+        b += blocks;
+    }
+
+    KeyedBlockVariant variant = keyedBlockVariant();
+    (encrypt ? variant.encrypt : variant.decrypt)(packed, packed, blockCount, blockKeys);
+
+    b = 0;
+    for(size_t i = 0; i < count; i++){
+        BatchMessage& message = messages[indices[i]];
+        size_t blocks = packedBlocks(message, encrypt);
+        const unsigned char* first = packed + b * BLOCK_SIZE;
+        b += blocks;
+        if(encrypt){
+            memcpy(message.out.data(), first, blocks * BLOCK_SIZE);
+            message.written = blocks * BLOCK_SIZE;
+            continue;
+        }
+        size_t padding = paddingLength(first + (blocks - 1) * BLOCK_SIZE, BLOCK_SIZE);
+        if(padding == 0) continue;
+        message.validKey = true;
+        message.written = message.in.size() - padding;
+        memcpy(message.out.data(), first, message.written);
+    }
+}
+
+void runBatch(Span<BatchMessage> messages, bool encrypt){
+    // Short 8-byte-block messages are packed in groups; the rest are handled one by one.
+    // Without SIMD kernels packing does not pay: the backend's own kernel beats the keyed
+    // 64-bit engine, so every message goes through encryptInto/decryptInto.
+    const bool packing = keyedBlockVariant().encrypt != encryptBlocksKeyed;
+    vector<size_t> packed, direct;
+    vector<size_t> groupEnds, groupBlocks;
+    size_t currentBlocks = 0, packedTotal = 0;
+    for(size_t i = 0; i < messages.size(); i++){
+        BatchMessage& message = messages[i];
+        message.written = 0;
+        message.validKey = false;
+        if(encrypt ? message.out.size() < encryptedSize(message.in.size(), message.schedule->blockSize)
+                   : message.in.empty() || message.in.size() % message.schedule->blockSize != 0 ||
+                     message.out.size() < message.in.size() - 1){
+            continue;
+        }
+        size_t blocks = packedBlocks(message, encrypt);
+        if(!packing || message.schedule->blockSize != BLOCK_SIZE || blocks > BATCH_MAX_MESSAGE_BLOCKS){
+            direct.push_back(i);
+            continue;
+        }
+        if(currentBlocks + blocks > BATCH_GROUP_BLOCKS){
+            groupEnds.push_back(packed.size());
+            groupBlocks.push_back(currentBlocks);
+            currentBlocks = 0;
+        }
+        packed.push_back(i);
+        currentBlocks += blocks;
+        packedTotal += blocks;
+    }
+    if(currentBlocks > 0){
+        groupEnds.push_back(packed.size());
+        groupBlocks.push_back(currentBlocks);
+    }
+
+    if(!groupEnds.empty()){
+        BITCASCADE_TIME_PHASE(encrypt ? PHASE_ENCRYPT_BLOCKS : PHASE_DECRYPT_BLOCKS);
+        BITCASCADE_ADD_BYTES(encrypt ? PHASE_ENCRYPT_BLOCKS : PHASE_DECRYPT_BLOCKS, (uint64_t)packedTotal * BLOCK_SIZE);
+        auto runGroup = [&](size_t group){
+            size_t first = group == 0 ? 0 : groupEnds[group - 1];
+            runBatchGroup(messages.data(), packed.data() + first, groupEnds[group] - first, groupBlocks[group], encrypt);
+        };
+        WorkStealingPool& pool = sharedPool();
+        if(groupEnds.size() == 1 || pool.threadCount() == 1 || WorkStealingPool::insideTask()){
+            for(size_t group = 0; group < groupEnds.size(); group++) runGroup(group);
+        } else {
+            pool.parallelFor(groupEnds.size(), runGroup);
+        }
+    }
+
+    for(size_t i : direct){
+        BatchMessage& message = messages[i];
+        if(encrypt){
+            message.written = encryptInto(message.in, message.out, *message.schedule);
+        } else {
+            message.written = decryptInto(message.in, message.out, *message.schedule, message.validKey);
+        }
+    }
+}
+}
+
+void encryptMany(Span<BatchMessage> messages){
+    runBatch(messages, true);
+}
+
+void decryptMany(Span<BatchMessage> messages){
+    runBatch(messages, false);
+}
+
+// ===================== CTR MODE =====================
+
+// Keystream generated per pass: small enough to stay in L1, a multiple of every block size
+constexpr size_t CTR_BATCH_BYTES = 4096;
+
+uint64_t makeNonce(){
+    random_device device;
+    return (uint64_t)device() << 32 ^ device();
+}
+
+// out = a ^ b, a word at a time (-O2 does not vectorize the byte loop)
+inline void xorBytes(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t length){
+    size_t i = 0;
+    for(; i + 8 <= length; i += 8){
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        x ^= y;
+        memcpy(out + i, &x, 8);
+    }
+    for(; i < length; i++) out[i] = a[i] ^ b[i];
+}
+
+// Little-endian like storeBlockWord, spelled out so the compiler merges it into one store
+inline void storeCounter(uint64_t counter, unsigned char* block){
+    block[0] = (unsigned char)counter;
+    block[1] = (unsigned char)(counter >> 8);
+    block[2] = (unsigned char)(counter >> 16);
+    block[3] = (unsigned char)(counter >> 24);
+    block[4] = (unsigned char)(counter >> 32);
+    block[5] = (unsigned char)(counter >> 40);
+    block[6] = (unsigned char)(counter >> 48);
+    block[7] = (unsigned char)(counter >> 56);
+}
+
+// XORs length bytes with the keystream from byte offset on; in may be null for the raw keystream
+void ctrRange(const uint8_t* in, uint8_t* out, size_t length, const KeySchedule& schedule, uint64_t nonce, uint64_t offset){
+    BlockVariant variant = blockVariant(schedule);
+    const size_t blockSize = variant.blockSize;
+    unsigned char keystream[CTR_BATCH_BYTES];
+    uint64_t counter = nonce + offset / blockSize;
+    size_t skip = offset % blockSize;
+    size_t done = 0;
+    while(done < length){
+        size_t blocks = min(CTR_BATCH_BYTES / blockSize, (skip + length - done + blockSize - 1) / blockSize);
+        if(blockSize != BLOCK_SIZE) memset(keystream, 0, blocks * blockSize);
+        for(size_t b = 0; b < blocks; b++){
+            storeCounter(counter + b, keystream + b * blockSize);
+        }
+        variant.encrypt(keystream, keystream, blocks, schedule);
+        
+        size_t count = min(blocks * blockSize - skip, length - done);
+        if(in){
+            xorBytes(in + done, keystream + skip, out + done, count);
+        } else {
+            memcpy(out + done, keystream + skip, count);
+        }
+        done += count;
+        counter += blocks;
+        skip = 0;
+    }
+}
+
+// Every chunk can seek straight to its own offset, so chunks run on the pool like ECB blocks
+void parallelCtr(const uint8_t* in, uint8_t* out, size_t length, const KeySchedule& schedule, uint64_t nonce, uint64_t offset){
+    BITCASCADE_TIME_PHASE(PHASE_CTR);
+    BITCASCADE_ADD_BYTES(PHASE_CTR, length);
+    WorkStealingPool& pool = sharedPool();
+    size_t chunkCount = (length + PARALLEL_CHUNK_BYTES - 1) / PARALLEL_CHUNK_BYTES;
+    if(chunkCount <= 1 || pool.threadCount() == 1 || WorkStealingPool::insideTask()){
+        ctrRange(in, out, length, schedule, nonce, offset);
+        return;
+    }
+    pool.parallelFor(chunkCount, [&](size_t chunk){
+        size_t first = chunk * PARALLEL_CHUNK_BYTES;
+        size_t count = min(PARALLEL_CHUNK_BYTES, length - first);
+        ctrRange(in ? in + first : nullptr, out + first, count, schedule, nonce, offset + first);
+    });
+}
+
+void ctrCrypt(Span<const uint8_t> in, Span<uint8_t> out, const KeySchedule& schedule, uint64_t nonce, uint64_t offset){
+    parallelCtr(in.data(), out.data(), min(in.size(), out.size()), schedule, nonce, offset);
+}
+
+void ctrKeystream(Span<uint8_t> out, const KeySchedule& schedule, uint64_t nonce, uint64_t offset){
+    parallelCtr(nullptr, out.data(), out.size(), schedule, nonce, offset);
+}
+
+vector<unsigned char> encryptTextCtr(const string& text, const KeySchedule& schedule, uint64_t nonce){
+    vector<unsigned char> encrypted(text.size());
+    ctrCrypt(Span<const uint8_t>((const uint8_t*)text.data(), text.size()), encrypted, schedule, nonce);
+    return encrypted;
+}
+
+string decryptTextCtr(const vector<unsigned char>& encrypted, const KeySchedule& schedule, uint64_t nonce){
+    string decrypted(encrypted.size(), '\0');
+    ctrCrypt(encrypted, Span<uint8_t>((uint8_t*)&decrypted[0], decrypted.size()), schedule, nonce);
+    return decrypted;
+}
+
+// ===================== KEY CHECK VALUE =====================
+
+uint32_t keyCheckValue(const KeySchedule& schedule){
+    return (uint32_t)encryptBlockWord(0, schedule);
+}
+
+ContainerHeader makeContainerHeader(uint64_t originalLength, const KeySchedule& schedule, ContainerMode mode){
+    ContainerHeader header;
+    header.blockSize = (unsigned char)schedule.blockSize;
+    header.rounds = TOTAL_ROUNDS;
+    header.mode = mode;
+    header.originalLength = originalLength;
+    header.keyCheck = keyCheckValue(schedule);
+    if(mode == MODE_CTR) header.nonce = makeNonce();
+    return header;
+}
+
+// ===================== STATISTICS =====================
+// Each thread owns one ThreadStats and is the only writer of it, so a counter update is
+// a relaxed load and store with no locked instruction. collectStats() reads every live
+// block under registryMutex; a thread that exits folds its counters into retiredStats.
+// The blocks come from calloc, since operator new itself is counted.
+
+const char* statPhaseName(StatPhase phase){
+    static const char* const NAMES[PHASE_COUNT] = {
+        "read_file", "hex_decode", "hex_encode", "key_expansion", "encrypt_blocks",
+        "decrypt_blocks", "padding_check", "ctr", "write_file",
+    };
+    return phase < PHASE_COUNT ? NAMES[phase] : "unknown";
+}
+
+bool statsCompiledIn(){
+#ifdef BITCASCADE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef BITCASCADE_STATS
+
+namespace {
+
+struct ThreadStats {
+    atomic<uint64_t> calls[PHASE_COUNT];
+    atomic<uint64_t> nanoseconds[PHASE_COUNT];
+    atomic<uint64_t> bytes[PHASE_COUNT];
+    atomic<uint64_t> allocations;
+    atomic<uint64_t> allocatedBytes;
+    ThreadStats* previous;
+    ThreadStats* next;
+};
+
+mutex registryMutex;
+ThreadStats* registryHead = nullptr;
+StatsSnapshot retiredStats;
+
+inline void addCounter(atomic<uint64_t>& counter, uint64_t amount){
+    counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void addThreadStats(StatsSnapshot& total, const ThreadStats& stats){
+    for(int phase = 0; phase < PHASE_COUNT; phase++){
+        total.phases[phase].calls += stats.calls[phase].load(memory_order_relaxed);
+        total.phases[phase].nanoseconds += stats.nanoseconds[phase].load(memory_order_relaxed);
+        total.phases[phase].bytes += stats.bytes[phase].load(memory_order_relaxed);
+    }
+    total.allocations += stats.allocations.load(memory_order_relaxed);
+    total.allocatedBytes += stats.allocatedBytes.load(memory_order_relaxed);
+}
+
+struct ThreadStatsSlot {
+    ThreadStats* stats = nullptr;
+    bool exited = false;
+
+    ~ThreadStatsSlot(){
+        exited = true;
+        if(!stats) return;
+        lock_guard<mutex> lock(registryMutex);
+        addThreadStats(retiredStats, *stats);
+        if(stats->previous) stats->previous->next = stats->next;
+        else registryHead = stats->next;
+        if(stats->next) stats->next->previous = stats->previous;
+        free(stats);
+        stats = nullptr;
+    }
+};
+
+thread_local ThreadStatsSlot threadStatsSlot;
+
+// nullptr while the thread is being torn down
+ThreadStats* threadStats(){
+    ThreadStatsSlot& slot = threadStatsSlot;
+    if(slot.stats || slot.exited) return slot.stats;
+    void* memory = calloc(1, sizeof(ThreadStats));
+    if(!memory) return nullptr;
+    ThreadStats* stats = ::new(memory) ThreadStats();
+    lock_guard<mutex> lock(registryMutex);
+    stats->next = registryHead;
+    if(registryHead) registryHead->previous = stats;
+    registryHead = stats;
+    slot.stats = stats;
+    return stats;
+}
+
+// Every allocation in the process is counted on the allocating thread
+void* countedAllocation(size_t size){
+    if(ThreadStats* stats = threadStats()){
+        addCounter(stats->allocations, 1);
+        addCounter(stats->allocatedBytes, size);
+    }
+    void* memory = malloc(size ? size : 1);
+    if(!memory) throw bad_alloc();
+    return memory;
+}
+
+}
+
+void recordPhase(StatPhase phase, uint64_t nanoseconds){
+    if(ThreadStats* stats = threadStats()){
+        addCounter(stats->calls[phase], 1);
+        addCounter(stats->nanoseconds[phase], nanoseconds);
+    }
+}
+
+void recordBytes(StatPhase phase, uint64_t bytes){
+    if(ThreadStats* stats = threadStats()) addCounter(stats->bytes[phase], bytes);
+}
+
+StatsSnapshot collectStats(){
+    lock_guard<mutex> lock(registryMutex);
+    StatsSnapshot total = retiredStats;
+    for(ThreadStats* stats = registryHead; stats; stats = stats->next) addThreadStats(total, *stats);
+    return total;
+}
+
+void resetStats(){
+    lock_guard<mutex> lock(registryMutex);
+    retiredStats = StatsSnapshot();
+    for(ThreadStats* stats = registryHead; stats; stats = stats->next){
+        // Racy against the owning thread, which may lose an update in flight
+        for(int phase = 0; phase < PHASE_COUNT; phase++){
+            stats->calls[phase].store(0, memory_order_relaxed);
+            stats->nanoseconds[phase].store(0, memory_order_relaxed);
+            stats->bytes[phase].store(0, memory_order_relaxed);
+        }
+        stats->allocations.store(0, memory_order_relaxed);
+        stats->allocatedBytes.store(0, memory_order_relaxed);
+    }
+}
+
+void* operator new(size_t size){ return countedAllocation(size); }
+void* operator new[](size_t size){ return countedAllocation(size); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+#else
+
+void recordPhase(StatPhase, uint64_t){}
+void recordBytes(StatPhase, uint64_t){}
+StatsSnapshot collectStats(){ return StatsSnapshot(); }
+void resetStats(){}
+
+#endif // BITCASCADE_STATS
+
+string formatStats(const StatsSnapshot& stats, bool json){
+    ostringstream out;
+    if(json){
+        out << "{\"enabled\": " << (statsCompiledIn() ? "true" : "false") << ", \"phases\": {";
+        for(int phase = 0; phase < PHASE_COUNT; phase++){
+            const PhaseStats& p = stats.phases[phase];
+            out << (phase ? ", " : "") << "\"" << statPhaseName((StatPhase)phase) << "\": {\"calls\": " << p.calls
+                << ", \"ns\": " << p.nanoseconds << ", \"bytes\": " << p.bytes << "}";
+        }
+        out << "}, \"allocations\": " << stats.allocations << ", \"allocated_bytes\": " << stats.allocatedBytes << "}";
+        return out.str();
+    }
+    if(!statsCompiledIn()) return "Statistics are not compiled in (build the library with -DBITCASCADE_STATS).\n";
+    out << left << setw(16) << "phase" << right << setw(10) << "calls" << setw(12) << "ms"
+        << setw(12) << "MB" << setw(10) << "MB/s" << "\n";
+    for(int phase = 0; phase < PHASE_COUNT; phase++){
+        const PhaseStats& p = stats.phases[phase];
+        if(p.calls == 0) continue;
+        double megabytes = p.bytes / (1024.0 * 1024.0);
+        double seconds = p.nanoseconds / 1e9;
+        out << left << setw(16) << statPhaseName((StatPhase)phase) << right << setw(10) << p.calls
+            << fixed << setprecision(3) << setw(12) << seconds * 1000 << setw(12) << megabytes
+            << setprecision(1) << setw(10) << (seconds > 0 ? megabytes / seconds : 0.0) << "\n";
+    }
+    out << "allocations: " << stats.allocations << " (" << stats.allocatedBytes << " bytes)\n";
+    return out.str();
+}
@@ -0,0 +1,389 @@
+#pragma once
+// libbitcascade: the BitCascade block cipher, its SIMD backends, the parallel bulk
+// engine and the ciphertext file formats, shared by the CLI (algorithm.cpp) and the
+// GUI (gui.cpp).
+//
+// The hot path is the span API: encryptInto/decryptInto read from one caller-provided
+// buffer and write into another without allocating. encryptText/decryptText and the
+// file functions are conveniences built on top of it.
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "container.h"
+#include "hexcodec.h"
+#include "bitcascade_block.h"
+#include "bitcascade_stats.h"
+
+constexpr int BLOCK_SIZE = 8;
+constexpr int TOTAL_ROUNDS = 5;
+
+// Opt-in wide-block variants: the same construction over 16, 32 or 64-byte blocks,
+// one block per SSE/AVX2/AVX-512 register. The block size is recorded in the container.
+constexpr int MAX_BLOCK_SIZE = 64;
+
+inline bool isSupportedBlockSize(unsigned blockSize){
+    return blockSize == 8 || blockSize == 16 || blockSize == 32 || blockSize == 64;
+}
+
+// The standard cipher as a compile-time specialized template
+typedef BitCascade<BLOCK_SIZE, TOTAL_ROUNDS> StandardCascade;
+
+// ===================== SPANS =====================
+// Non-owning view of a contiguous buffer (std::span is C++20)
+
+template<typename T>
+class Span {
+public:
+    Span() = default;
+    Span(T* data, size_t size) : pointer(data), length(size) {}
+    // Any contiguous container or span whose data() converts to T* (vector, array, Span<U>)
+    template<typename Container, typename = typename std::enable_if<
+        std::is_convertible<decltype(std::declval<Container&>().data()), T*>::value>::type>
+    Span(Container&& container) : pointer(container.data()), length(container.size()) {}
+
+    T* data() const { return pointer; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    T& operator[](size_t i) const { return pointer[i]; }
+    T* begin() const { return pointer; }
+    T* end() const { return pointer + length; }
+    Span subspan(size_t offset, size_t count) const { return Span(pointer + offset, count); }
+
+private:
+    T* pointer = nullptr;
+    size_t length = 0;
+};
+
+// ===================== KEY SCHEDULE AND BLOCK PRIMITIVES =====================
+
+unsigned char rotateLeft(unsigned char byte, int n);
+unsigned char rotateRight(unsigned char byte, int n);
+std::vector<unsigned char> generateSubkey(const std::string& key, int round);
+
+// Expanded subkeys for every round, computed once per key instead of once per block
+struct KeySchedule {
+    unsigned char subkeys[TOTAL_ROUNDS][BLOCK_SIZE];
+    uint64_t subkeyWords[TOTAL_ROUNDS]; // same subkeys packed little-endian for the 64-bit engine
+    unsigned char wideSubkeys[TOTAL_ROUNDS][MAX_BLOCK_SIZE]; // every position of the widest block
+    unsigned blockSize = BLOCK_SIZE; // block variant used by the bulk, text and file functions
+
+    // blockSize must satisfy isSupportedBlockSize
+    explicit KeySchedule(const std::string& key, unsigned blockSize = BLOCK_SIZE);
+    KeySchedule withBlockSize(unsigned blockSize) const;
+};
+
+// The 8-byte-block subkeys depend on the key only through its key word: byte i is
+// key[i % key.size()] for i < 8. Keys with the same word ("ab" and "abab", or two keys
+// sharing their first 8 characters) have the same 8-byte-block subkeys.
+uint64_t keyWord(const std::string& key);
+// KeySchedule::subkeyWords for a key word, without expanding the wide subkeys
+void expandKeyWord(uint64_t keyWord, uint64_t (&subkeyWords)[TOTAL_ROUNDS]);
+
+// Bounded LRU cache of expanded schedules, for processes that see the same keys again and
+// again. Entries are spread over shards by the hash of (key, block size); each shard has
+// its own lock and LRU list, so threads working under different keys rarely contend.
+// The cache holds the keys themselves, which a schedule reveals anyway.
+class KeyScheduleCache {
+public:
+    struct Counters {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    explicit KeyScheduleCache(size_t capacity = 4096, size_t shardCount = 16);
+    ~KeyScheduleCache();
+
+    // Schedule for key with the given block size, expanded on a miss. The returned
+    // schedule stays valid after it is evicted.
+    std::shared_ptr<const KeySchedule> get(const std::string& key, unsigned blockSize = BLOCK_SIZE);
+
+    Counters counters() const;
+    size_t size() const;
+    void clear();
+
+private:
+    struct Shard;
+    Shard& shardFor(size_t hash) const;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardCapacity;
+};
+
+// Process-wide cache used by the GUI and the batch runner
+KeyScheduleCache& sharedKeyCache();
+
+// Reference byte-wise implementation of one round step / one block
+void confusion(std::vector<unsigned char>& block, const unsigned char (&subkey)[BLOCK_SIZE], int round);
+void difusion(std::vector<unsigned char>& block);
+void inverseDifusion(std::vector<unsigned char>& block);
+void inverseConfusion(std::vector<unsigned char>& block, const unsigned char (&subkey)[BLOCK_SIZE], int round);
+std::vector<unsigned char> encryptBlock(std::vector<unsigned char> block, const KeySchedule& schedule);
+std::vector<unsigned char> decryptBlock(std::vector<unsigned char> block, const KeySchedule& schedule);
+
+// One block held in a uint64_t (byte i = bits 8i..8i+7)
+uint64_t encryptBlockWord(uint64_t block, const KeySchedule& schedule);
+uint64_t decryptBlockWord(uint64_t block, const KeySchedule& schedule);
+
+// 64-bit engine over blockCount consecutive blocks; in and out may be the same buffer
+void encryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule& schedule);
+void decryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule& schedule);
+
+// Same engine with one key per block: blockKeys[b] points to the TOTAL_ROUNDS subkey
+// words of block b (a schedule's subkeyWords), so neighbouring blocks may use different keys
+void encryptBlocksKeyed(const unsigned char* in, unsigned char* out, size_t blockCount,
+                        const uint64_t* const* blockKeys);
+void decryptBlocksKeyed(const unsigned char* in, unsigned char* out, size_t blockCount,
+                        const uint64_t* const* blockKeys);
+
+// ===================== BACKEND DISPATCH =====================
+// The CPU is probed once; the bulk paths call through blockBackend().
+// BITCASCADE_BACKEND=<name> or selectBackend() forces a specific backend.
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool avx2 = false;
+    bool avx512bw = false;
+};
+
+const CpuFeatures& cpuFeatures();
+
+typedef void (*BlockFunction)(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule& schedule);
+
+struct BlockBackend {
+    const char* name;
+    BlockFunction encrypt;
+    BlockFunction decrypt;
+    bool (*supported)();
+};
+
+// Fastest first; the last entry is always usable
+extern const BlockBackend BLOCK_BACKENDS[];
+extern const size_t BLOCK_BACKEND_COUNT;
+
+const BlockBackend* findBackend(const std::string& name);
+const BlockBackend& blockBackend();
+// Switches to the named backend; warns and keeps the current one if it is unknown or unsupported
+bool selectBackend(const std::string& name);
+
+// Kernels for one block size; blockCount counts blocks of blockSize bytes
+struct BlockVariant {
+    unsigned blockSize;
+    BlockFunction encrypt;
+    BlockFunction decrypt;
+};
+
+// The active backend for 8-byte blocks; wide blocks use the SIMD kernels of the active
+// backend's instruction set (avx2/avx512) and the unrolled template otherwise
+BlockVariant blockVariant(const KeySchedule& schedule);
+
+// Multi-key kernels for 8-byte blocks (see encryptBlocksKeyed): every 64-bit SIMD lane
+// fetches its own subkey word, so blocks of many keys share one register
+typedef void (*KeyedBlockFunction)(const unsigned char* in, unsigned char* out, size_t blockCount,
+                                   const uint64_t* const* blockKeys);
+
+struct KeyedBlockVariant {
+    KeyedBlockFunction encrypt;
+    KeyedBlockFunction decrypt;
+};
+
+// The kernels of the active backend's instruction set; the 64-bit engine otherwise
+KeyedBlockVariant keyedBlockVariant();
+
+// ===================== PARALLEL BULK ENCRYPTION =====================
+// Blocks are independent, so large buffers are cut into cache-sized chunks and
+// spread over a pool of threads. Every participant has its own deque of chunk
+// indices; idle participants steal from the back of someone else's deque.
+
+constexpr size_t PARALLEL_CHUNK_BYTES = 64 * 1024;
+
+class WorkStealingPool {
+public:
+    // threadCount includes the calling thread; 0 means one per hardware thread
+    explicit WorkStealingPool(unsigned threadCount = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned threadCount() const { return (unsigned)queues.size(); }
+
+    // True while the current thread is running a pool task (nested parallelFor calls would deadlock)
+    static bool insideTask();
+
+    // Runs task(i) for every i in [0, taskCount) and waits for all of them.
+    // The first exception thrown by a task is rethrown here. Not reentrant.
+    void parallelFor(size_t taskCount, const std::function<void(size_t)>& task);
+
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex submitLock;
+    std::mutex stateLock;
+    std::condition_variable wakeUp;
+    std::condition_variable allDone;
+    const std::function<void(size_t)>* currentTask = nullptr;
+    size_t pending = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+    std::exception_ptr firstError;
+
+    bool popOwn(size_t self, size_t& index);
+    bool steal(size_t self, size_t& index);
+    void runTasks(size_t self);
+    void workerLoop(size_t self);
+};
+
+// Thread count of the shared pool; only takes effect before its first use (0 = all hardware threads)
+void setSharedPoolThreads(unsigned threadCount);
+unsigned sharedPoolThreads();
+WorkStealingPool& sharedPool();
+
+// Runs blockVariant(schedule) over blockCount blocks of schedule.blockSize bytes on the pool.
+// out must already hold blockCount blocks; in and out may be the same buffer.
+void parallelEncryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule& schedule,
+                           WorkStealingPool& pool = sharedPool());
+void parallelDecryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const KeySchedule& schedule,
+                           WorkStealingPool& pool = sharedPool());
+
+// ===================== SPAN API =====================
+
+// Ciphertext length for a plaintext of the given length (PKCS7 always adds 1..blockSize bytes)
+inline size_t encryptedSize(size_t plaintextLength, unsigned blockSize = BLOCK_SIZE){
+    return (plaintextLength / blockSize + 1) * blockSize;
+}
+
+// All of the span, text and file functions use schedule.blockSize blocks.
+// Pads and encrypts in into out, which needs encryptedSize(in.size(), schedule.blockSize) bytes.
+// in and out may start at the same address. Returns the bytes written, or 0 if out is too small.
+size_t encryptInto(Span<const uint8_t> in, Span<uint8_t> out, const KeySchedule& schedule);
+
+// Decrypts in into out and strips the padding; out needs in.size() - 1 bytes
+// (the padded tail is decrypted on the stack). in and out may start at the same address.
+// Returns the plaintext length; validKey is false when the length or padding is wrong.
+size_t decryptInto(Span<const uint8_t> in, Span<uint8_t> out, const KeySchedule& schedule, bool& validKey);
+
+// PKCS7 padding length of a decrypted final block, or 0 if the padding is malformed
+size_t paddingLength(const unsigned char* tail, size_t blockSize);
+
+// Decrypts only the final block and checks its padding, so a wrong key is rejected in
+// constant time before any bulk work. Returns the plaintext length; validKey is false
+// when the length or padding is wrong. A random block passes about once in 256 tries,
+// which is why containers also carry a key check value.
+size_t checkTailBlock(Span<const uint8_t> encrypted, const KeySchedule& schedule, bool& validKey);
+
+std::vector<unsigned char> encryptText(const std::string& text, const KeySchedule& schedule);
+std::string decryptText(const std::vector<unsigned char>& encrypted, const KeySchedule& schedule, bool& validKey);
+
+// ===================== BATCH API =====================
+// Many short messages, each with its own schedule, are packed block by block into one
+// buffer and run through the multi-key kernels together, then the results and padding
+// are scattered back. A batch of 100-byte messages thus fills the SIMD lanes like one
+// large buffer would, instead of paying a call and a half-empty register per message.
+
+struct BatchMessage {
+    Span<const uint8_t> in;
+    Span<uint8_t> out;                    // sized as for encryptInto / decryptInto
+    const KeySchedule* schedule = nullptr;
+    size_t written = 0;                   // bytes written to out, 0 on failure
+    bool validKey = false;                // decryptMany: the length and padding were correct
+};
+
+// Messages of up to this many blocks are packed; longer ones, wide-block schedules and
+// every message on a backend without SIMD go through encryptInto/decryptInto on their own
+constexpr size_t BATCH_MAX_MESSAGE_BLOCKS = 256;
+
+// Each message's out may start at the same address as its in; otherwise the buffers
+// of different messages must not overlap. Large batches run on the shared pool.
+void encryptMany(Span<BatchMessage> messages);
+void decryptMany(Span<BatchMessage> messages);
+
+// ===================== CTR MODE =====================
+// Keystream block i is the encryption of the counter block nonce + i (little-endian in
+// the first 8 bytes, zero in the rest of a wide block); data is XORed with the keystream.
+// Nothing is padded, encryption and decryption are the same operation, and any byte
+// offset can be processed on its own, so streams need no look-ahead and can seek.
+
+// A fresh random nonce; a nonce must never be reused with the same key
+uint64_t makeNonce();
+
+// XORs in with the keystream from byte offset on into out (same size; in and out may be
+// the same buffer). Keystream is generated a few KB at a time; large spans run on the pool.
+void ctrCrypt(Span<const uint8_t> in, Span<uint8_t> out, const KeySchedule& schedule, uint64_t nonce, uint64_t offset = 0);
+// Writes the raw keystream from byte offset on into out, e.g. to precompute it ahead of the data
+void ctrKeystream(Span<uint8_t> out, const KeySchedule& schedule, uint64_t nonce, uint64_t offset = 0);
+
+// The ciphertext is exactly as long as the text
+std::vector<unsigned char> encryptTextCtr(const std::string& text, const KeySchedule& schedule, uint64_t nonce);
+std::string decryptTextCtr(const std::vector<unsigned char>& encrypted, const KeySchedule& schedule, uint64_t nonce);
+
+// ===================== CIPHERTEXT FILES =====================
+// Ciphertext is saved as a binary container (see container.h) or, on request, as
+// hex text. Reading accepts both. Errors are reported on cout.
+
+// Prints a message for a failed hex decode; returns true for HEX_OK
+bool reportHexError(HexStatus status, uint64_t errorOffset);
+bool hexStringToBytes(const std::string& hexStr, std::vector<unsigned char>& output);
+std::string bytesToHexString(const std::vector<unsigned char>& data);
+
+// First 4 bytes of an all-zero 8-byte block encrypted with the key, whatever schedule.blockSize is
+uint32_t keyCheckValue(const KeySchedule& schedule);
+// MODE_CTR headers get a fresh nonce from makeNonce()
+ContainerHeader makeContainerHeader(uint64_t originalLength, const KeySchedule& schedule, ContainerMode mode = MODE_ECB);
+// Checks that a container was written by this version of the cipher
+bool supportedContainer(const ContainerHeader& header);
+
+struct FileOptions {
+    bool hexOutput = false; // write hex text instead of a binary container
+    bool mapped = false;    // use memory-mapped I/O where available (binary containers only)
+    ContainerMode mode = MODE_ECB; // mode for new files (MODE_CTR needs a binary container)
+};
+
+bool saveToFile(const std::string& filename, const std::string& content);
+bool readFromFile(const std::string& filename, std::string& content);
+// Hex text only holds 8-byte ECB ciphertext, since it has no header
+bool saveCiphertext(const std::string& filename, const std::vector<unsigned char>& encrypted, const ContainerHeader& header,
+                    const FileOptions& options = FileOptions());
+// Splits file content into ciphertext bytes and, for containers, the header
+bool parseCiphertext(const std::string& content, std::vector<unsigned char>& ciphertext, ContainerHeader& header, bool& hasHeader);
+
+// Files are processed STREAM_CHUNK_BYTES at a time, so memory use does not grow with the file size
+constexpr size_t STREAM_CHUNK_BYTES = 1024 * 1024;
+
+// Container output needs a seekable stream: the length is patched into the header at the end
+bool encryptStream(std::istream& in, std::ostream& out, const KeySchedule& schedule, bool hexOutput,
+                   ContainerMode mode = MODE_ECB);
+// Returns false on I/O or format errors; validKey reports whether the key check and padding passed
+bool decryptStream(std::istream& in, std::ostream& out, const KeySchedule& schedule, bool& validKey);
+
+bool encryptFile(const std::string& inputName, const std::string& outputName, const KeySchedule& schedule,
+                 const FileOptions& options = FileOptions());
+// On failure no partially decrypted output is left behind
+bool decryptFile(const std::string& inputName, const std::string& outputName, const KeySchedule& schedule, bool& validKey,
+                 const FileOptions& options = FileOptions());
+
+// Decrypts plaintext bytes [offset, offset + length) of a binary container into plaintext,
+// clipped to the plaintext length. Only the blocks covering the range are read (with
+// pread where available) and decrypted; the padding is checked only when the range
+// reaches the end. Returns false on I/O or format errors; validKey as for decryptFile.
+bool decryptFileRange(const std::string& inputName, uint64_t offset, uint64_t length, std::vector<unsigned char>& plaintext,
+                      const KeySchedule& schedule, bool& validKey);
@@ -0,0 +1,151 @@
+#pragma once
+// Compile-time specialized BitCascade round function.
+//
+// BitCascade<BlockSize, Rounds> is the same construction as the reference
+// confusion/difusion code in bitcascade.cpp, but the block size and round count are
+// template parameters: the round loop and every byte loop are unrolled with fold
+// expressions, and the rotation amounts, round offsets and zig-zag permutation are
+// compile-time constants. BitCascade<BLOCK_SIZE, TOTAL_ROUNDS> is the standard cipher;
+// other sizes can be instantiated without writing new code.
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+
+template<size_t BlockSize, int Rounds>
+struct BitCascade {
+    static_assert(BlockSize >= 2, "BitCascade needs at least two bytes per block");
+    static_assert(Rounds >= 1, "BitCascade needs at least one round");
+
+    static constexpr size_t blockSize = BlockSize;
+    static constexpr int rounds = Rounds;
+
+    typedef unsigned char Subkeys[Rounds][BlockSize];
+
+    // Byte i moves to position zigzag(i) at the end of difusion
+    static constexpr size_t zigzag(size_t i){
+        return (i % 2 == 0) ? BlockSize - 1 - i / 2 : i / 2;
+    }
+
+    // Byte i is rotated left by i + 1 in difusion (a rotation by 8 is a no-op)
+    static constexpr unsigned rotation(size_t i){
+        return (unsigned)((i + 1) & 7);
+    }
+
+    // The "i * i + round * 7" term of confusion
+    static constexpr unsigned char offset(int round, size_t i){
+        return (unsigned char)(i * i + (size_t)round * 7);
+    }
+
+    // subkeys[round][i] = (round + key[i % key.size()] + i * i) % 256; key must not be empty
+    static void expandKey(const std::string& key, Subkeys& subkeys){
+        for(int round = 0; round < Rounds; round++){
+            for(size_t i = 0; i < BlockSize; i++){
+                subkeys[round][i] = (unsigned char)(round + key[i % key.size()] + i * i);
+            }
+        }
+    }
+
+    static void encryptBlock(const unsigned char* in, unsigned char* out, const Subkeys& subkeys){
+        unsigned char block[BlockSize];
+        memcpy(block, in, BlockSize);
+        encryptRounds(block, subkeys, std::make_integer_sequence<int, Rounds>());
+        memcpy(out, block, BlockSize);
+    }
+
+    static void decryptBlock(const unsigned char* in, unsigned char* out, const Subkeys& subkeys){
+        unsigned char block[BlockSize];
+        memcpy(block, in, BlockSize);
+        decryptRounds(block, subkeys, std::make_integer_sequence<int, Rounds>());
+        memcpy(out, block, BlockSize);
+    }
+
+    // blockCount consecutive blocks; in and out may be the same buffer
+    static void encryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const Subkeys& subkeys){
+        for(size_t b = 0; b < blockCount; b++){
+            encryptBlock(in + b * BlockSize, out + b * BlockSize, subkeys);
+        }
+    }
+
+    static void decryptBlocks(const unsigned char* in, unsigned char* out, size_t blockCount, const Subkeys& subkeys){
+        for(size_t b = 0; b < blockCount; b++){
+            decryptBlock(in + b * BlockSize, out + b * BlockSize, subkeys);
+        }
+    }
+
+private:
+    typedef unsigned char Block[BlockSize];
+    typedef std::make_index_sequence<BlockSize> Bytes;
+    typedef std::make_index_sequence<BlockSize - 1> Links; // neighbouring byte pairs
+
+    template<unsigned N>
+    static unsigned char rotateLeft(unsigned char x){
+        return N == 0 ? x : (unsigned char)(x << N | x >> ((8 - N) & 7));
+    }
+
+    template<unsigned N>
+    static unsigned char rotateRight(unsigned char x){
+        return N == 0 ? x : (unsigned char)(x >> N | x << ((8 - N) & 7));
+    }
+
+    template<int Round, size_t... I>
+    static void confuseAndRotate(Block& block, const Subkeys& subkeys, std::index_sequence<I...>){
+        ((block[I] = rotateLeft<rotation(I)>((unsigned char)((block[I] ^ subkeys[Round][I]) + offset(Round, I)))), ...);
+    }
+
+    template<int Round, size_t... I>
+    static void unrotateAndUnconfuse(Block& block, const Subkeys& subkeys, std::index_sequence<I...>){
+        ((block[I] = (unsigned char)((unsigned char)(rotateRight<rotation(I)>(block[I]) - offset(Round, I)) ^ subkeys[Round][I])), ...);
+    }
+
+    // block[i] ^= block[i - 1], front to back (the comma fold runs left to right)
+    template<size_t... I>
+    static void prefixXor(Block& block, std::index_sequence<I...>){
+        ((block[I + 1] ^= block[I]), ...);
+    }
+
+    // Undoes prefixXor back to front
+    template<size_t... I>
+    static void inversePrefixXor(Block& block, std::index_sequence<I...>){
+        ((block[BlockSize - 1 - I] ^= block[BlockSize - 2 - I]), ...);
+    }
+
+    template<size_t... I>
+    static void transpose(Block& block, std::index_sequence<I...>){
+        Block moved;
+        ((moved[zigzag(I)] = block[I]), ...);
+        memcpy(block, moved, BlockSize);
+    }
+
+    template<size_t... I>
+    static void inverseTranspose(Block& block, std::index_sequence<I...>){
+        Block moved;
+        ((moved[I] = block[zigzag(I)]), ...);
+        memcpy(block, moved, BlockSize);
+    }
+
+    template<int Round>
+    static void encryptRound(Block& block, const Subkeys& subkeys){
+        confuseAndRotate<Round>(block, subkeys, Bytes());
+        prefixXor(block, Links());
+        transpose(block, Bytes());
+    }
+
+    template<int Round>
+    static void decryptRound(Block& block, const Subkeys& subkeys){
+        inverseTranspose(block, Bytes());
+        inversePrefixXor(block, Links());
+        unrotateAndUnconfuse<Round>(block, subkeys, Bytes());
+    }
+
+    template<int... R>
+    static void encryptRounds(Block& block, const Subkeys& subkeys, std::integer_sequence<int, R...>){
+        (encryptRound<R>(block, subkeys), ...);
+    }
+
+    template<int... R>
+    static void decryptRounds(Block& block, const Subkeys& subkeys, std::integer_sequence<int, R...>){
+        (decryptRound<Rounds - 1 - R>(block, subkeys), ...);
+    }
+};
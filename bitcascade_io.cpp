@@ -0,0 +1,784 @@
+#include "bitcascade.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#if defined(__unix__) || defined(__APPLE__)
+#define BITCASCADE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// ===================== HEX TEXT =====================
+
+bool reportHexError(HexStatus status, uint64_t errorOffset){
+    if(status == HEX_ODD_LENGTH){
+        cout << "Error: Invalid hexadecimal length (must be even)." << endl;
+    } else if(status == HEX_INVALID_CHARACTER){
+        cout << "Error: Invalid hexadecimal character at offset " << errorOffset << "." << endl;
+    }
+    return status == HEX_OK;
+}
+
+bool hexStringToBytes(const string& hexStr, vector<unsigned char>& output) {
+    BITCASCADE_TIME_PHASE(PHASE_HEX_DECODE);
+    BITCASCADE_ADD_BYTES(PHASE_HEX_DECODE, hexStr.size());
+    output.resize((hexStr.size() + 1) / 2);
+    size_t written = 0;
+    uint64_t errorOffset = 0;
+    HexStatus status = hexDecode(hexStr.data(), hexStr.size(), output.data(), written, errorOffset);
+    output.resize(written);
+    return reportHexError(status, errorOffset);
+}
+
+string bytesToHexString(const vector<unsigned char>& data) {
+    BITCASCADE_TIME_PHASE(PHASE_HEX_ENCODE);
+    BITCASCADE_ADD_BYTES(PHASE_HEX_ENCODE, data.size());
+    string hexStr(data.size() * 2, '\0');
+    hexEncode(data.data(), data.size(), &hexStr[0]);
+    return hexStr;
+}
+
+// ===================== FILES =====================
+
+bool saveToFile(const string& filename, const string& content){
+    BITCASCADE_TIME_PHASE(PHASE_WRITE_FILE);
+    BITCASCADE_ADD_BYTES(PHASE_WRITE_FILE, content.size());
+    ofstream file(filename);
+    if(!file.is_open()){
+        cout << "Error: Could not open file for writing." << endl;
+        return false;
+    }
+    file << content;
+    file.close();
+    return true;
+}
+
+// Opening the output truncates it, so writing onto the input would destroy the input first
+bool distinctOutputFile(const string& inputName, const string& outputName){
+#ifdef BITCASCADE_MMAP
+    struct stat inputInfo, outputInfo;
+    bool same = stat(inputName.c_str(), &inputInfo) == 0 && stat(outputName.c_str(), &outputInfo) == 0 &&
+                inputInfo.st_dev == outputInfo.st_dev && inputInfo.st_ino == outputInfo.st_ino;
+#else
+    bool same = inputName == outputName;
+#endif
+    if(same) cout << "Error: Output file must be different from the input file." << endl;
+    return !same;
+}
+
+// Checked before an output is opened, since a failed call only deletes outputs it created
+bool fileExists(const string& filename){
+    return ifstream(filename).is_open();
+}
+
+bool readFromFile(const string& filename, string& content){
+    BITCASCADE_TIME_PHASE(PHASE_READ_FILE);
+    ifstream file(filename, ios::binary);
+    if(!file.is_open()){
+        cout << "Error: Could not open file for reading." << endl;
+        return false;
+    }
+    stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    file.close();
+    BITCASCADE_ADD_BYTES(PHASE_READ_FILE, content.size());
+    return true;
+}
+
+// ===================== CIPHERTEXT FILES =====================
+
+// Hex text has no header to record the block size or nonce in, so it only holds 8-byte ECB blocks
+bool hexCanHold(unsigned blockSize, ContainerMode mode){
+    if(blockSize != BLOCK_SIZE){
+        cout << "Error: Wide-block ciphertext needs the binary container (no --hex)." << endl;
+        return false;
+    }
+    if(mode != MODE_ECB){
+        cout << "Error: CTR ciphertext needs the binary container (no --hex)." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool supportedContainer(const ContainerHeader& header){
+    if(header.version != CONTAINER_VERSION || !isSupportedBlockSize(header.blockSize) ||
+       header.rounds != TOTAL_ROUNDS || (header.mode != MODE_ECB && header.mode != MODE_CTR)){
+        cout << "Error: Unsupported ciphertext container (version " << (int)header.version
+             << ", block size " << (int)header.blockSize << ", rounds " << (int)header.rounds
+             << ", mode " << (int)header.mode << ")." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool saveCiphertext(const string& filename, const vector<unsigned char>& encrypted, const ContainerHeader& header,
+                    const FileOptions& options){
+    if(options.hexOutput){
+        if(!hexCanHold(header.blockSize, (ContainerMode)header.mode)) return false;
+        return saveToFile(filename, bytesToHexString(encrypted));
+    }
+    BITCASCADE_TIME_PHASE(PHASE_WRITE_FILE);
+    BITCASCADE_ADD_BYTES(PHASE_WRITE_FILE, encrypted.size());
+    ofstream file(filename, ios::binary | ios::trunc);
+    if(!file.is_open()){
+        cout << "Error: Could not open file for writing." << endl;
+        return false;
+    }
+    unsigned char encoded[CONTAINER_MAX_HEADER_SIZE];
+    file.write((const char*)encoded, encodeContainerHeader(header, encoded));
+    file.write((const char*)encrypted.data(), encrypted.size());
+    return (bool)file;
+}
+
+bool parseCiphertext(const string& content, vector<unsigned char>& ciphertext, ContainerHeader& header, bool& hasHeader){
+    const unsigned char* data = (const unsigned char*)content.data();
+    hasHeader = decodeContainerHeader(data, content.size(), header);
+    if(!hasHeader){
+        return hexStringToBytes(content, ciphertext);
+    }
+    if(!supportedContainer(header)) return false;
+    ciphertext.assign(data + containerHeaderSize(header), data + content.size());
+    if(!containerLengthMatches(header, ciphertext.size())){
+        cout << "Error: Ciphertext length does not match the container header." << endl;
+        return false;
+    }
+    return true;
+}
+
+// ===================== STREAMING FILE ENCRYPTION =====================
+// In ECB mode only the final chunk gets PKCS7 padding; CTR chunks are XORed with the
+// keystream at their own offset and nothing is padded.
+
+// Chunk reads and writes of the streaming paths, timed as file phases
+void readChunk(istream& in, void* data, size_t length){
+    BITCASCADE_TIME_PHASE(PHASE_READ_FILE);
+    in.read((char*)data, (streamsize)length);
+    BITCASCADE_ADD_BYTES(PHASE_READ_FILE, (uint64_t)in.gcount());
+}
+
+void writeChunk(ostream& out, const void* data, size_t length){
+    BITCASCADE_TIME_PHASE(PHASE_WRITE_FILE);
+    BITCASCADE_ADD_BYTES(PHASE_WRITE_FILE, length);
+    out.write((const char*)data, (streamsize)length);
+}
+
+void writeHex(ostream& out, const unsigned char* data, size_t length, string& scratch){
+    scratch.resize(length * 2);
+    {
+        BITCASCADE_TIME_PHASE(PHASE_HEX_ENCODE);
+        BITCASCADE_ADD_BYTES(PHASE_HEX_ENCODE, length);
+        hexEncode(data, length, &scratch[0]);
+    }
+    writeChunk(out, scratch.data(), scratch.size());
+}
+
+// Reads plaintext from in and writes the ciphertext to out chunk by chunk
+bool encryptStream(istream& in, ostream& out, const KeySchedule& schedule, bool hexOutput, ContainerMode mode){
+    // Reused across calls so batches of small files do not allocate a chunk each
+    static thread_local vector<unsigned char> buffer(STREAM_CHUNK_BYTES + MAX_BLOCK_SIZE);
+    const size_t blockSize = schedule.blockSize;
+    string hexChunk;
+    uint64_t totalLength = 0;
+    ContainerHeader header = makeContainerHeader(0, schedule, mode);
+    unsigned char encoded[CONTAINER_MAX_HEADER_SIZE];
+    
+    if(hexOutput && !hexCanHold(schedule.blockSize, mode)) return false;
+    if(!hexOutput){
+        out.write((const char*)encoded, encodeContainerHeader(header, encoded));
+    }
+    
+    while(true){
+        readChunk(in, buffer.data(), STREAM_CHUNK_BYTES);
+        size_t length = (size_t)in.gcount();
+        if(in.bad()){
+            cout << "Error: Could not read input." << endl;
+            return false;
+        }
+        
+        // A short read means end of input
+        bool finalChunk = length < STREAM_CHUNK_BYTES;
+        if(mode == MODE_CTR){
+            ctrCrypt(Span<const uint8_t>(buffer.data(), length), Span<uint8_t>(buffer.data(), length), schedule, header.nonce, totalLength);
+            totalLength += length;
+        } else {
+            totalLength += length;
+            if(finalChunk){
+                unsigned char padding = (unsigned char)(blockSize - length % blockSize);
+                fill(buffer.begin() + length, buffer.begin() + length + padding, padding);
+                length += padding;
+            }
+            parallelEncryptBlocks(buffer.data(), buffer.data(), length / blockSize, schedule);
+        }
+        
+        if(hexOutput){
+            writeHex(out, buffer.data(), length, hexChunk);
+        } else {
+            writeChunk(out, buffer.data(), length);
+        }
+        if(!out){
+            cout << "Error: Could not write output." << endl;
+            return false;
+        }
+        if(finalChunk) break;
+    }
+    
+    if(!hexOutput){
+        header.originalLength = totalLength;
+        encodeContainerHeader(header, encoded);
+        out.seekp(0);
+        out.write((const char*)encoded, CONTAINER_HEADER_SIZE);
+        out.seekp(0, ios::end);
+        if(!out){
+            cout << "Error: Could not write output." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decrypts and writes every complete block except the last one, which carries the padding
+bool flushCiphertext(vector<unsigned char>& pending, ostream& out, const KeySchedule& schedule, uint64_t& written){
+    const size_t blockSize = schedule.blockSize;
+    size_t ready = pending.empty() ? 0 : (pending.size() - 1) / blockSize * blockSize;
+    parallelDecryptBlocks(pending.data(), pending.data(), ready / blockSize, schedule);
+    writeChunk(out, pending.data(), ready);
+    pending.erase(pending.begin(), pending.begin() + ready);
+    written += ready;
+    if(!out){
+        cout << "Error: Could not write output." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Decrypts the held-back last block and writes it without its padding
+bool finishCiphertext(vector<unsigned char>& pending, ostream& out, const KeySchedule& schedule, bool& validKey, uint64_t& written){
+    const size_t blockSize = schedule.blockSize;
+    if(pending.size() != blockSize){
+        cout << "Error: Ciphertext is not a whole number of blocks." << endl;
+        return false;
+    }
+    blockVariant(schedule).decrypt(pending.data(), pending.data(), 1, schedule);
+    size_t padding = paddingLength(pending.data(), blockSize);
+    if(padding == 0) return true;
+    validKey = true;
+    writeChunk(out, pending.data(), blockSize - padding);
+    written += blockSize - padding;
+    return (bool)out;
+}
+
+// CTR body of decryptStream; pending holds the ciphertext bytes read along with the header
+bool decryptCtrStream(istream& in, ostream& out, const KeySchedule& schedule, const ContainerHeader& header,
+                      vector<unsigned char>& pending, bool& validKey){
+    uint64_t offset = 0;
+    while(true){
+        ctrCrypt(pending, pending, schedule, header.nonce, offset);
+        writeChunk(out, pending.data(), pending.size());
+        offset += pending.size();
+        if(!out){
+            cout << "Error: Could not write output." << endl;
+            return false;
+        }
+        if(!in) break;
+        pending.resize(STREAM_CHUNK_BYTES);
+        readChunk(in, pending.data(), STREAM_CHUNK_BYTES);
+        pending.resize((size_t)in.gcount());
+    }
+    if(in.bad()){
+        cout << "Error: Could not read input." << endl;
+        return false;
+    }
+    if(offset != header.originalLength){
+        cout << "Error: Ciphertext length does not match the container header." << endl;
+        return false;
+    }
+    // There is no padding to check; the key check value already matched
+    validKey = true;
+    return true;
+}
+
+// Decodes the last block of hex text, skipping whitespace. Returns false if the text holds
+// fewer digits or a bad character comes first; the full decode reports those.
+bool lastHexBlock(const char* text, size_t length, unsigned char (&block)[BLOCK_SIZE]){
+    unsigned char nibbles[2 * BLOCK_SIZE];
+    size_t digits = 0;
+    for(size_t i = length; i-- > 0 && digits < sizeof(nibbles);){
+        signed char value = HEX_TABLES.values[(unsigned char)text[i]];
+        if(value == HEX_SKIP) continue;
+        if(value < 0) return false;
+        nibbles[sizeof(nibbles) - 1 - digits++] = (unsigned char)value;
+    }
+    if(digits < sizeof(nibbles)) return false;
+    for(size_t i = 0; i < BLOCK_SIZE; i++){
+        block[i] = (unsigned char)(nibbles[2 * i] << 4 | nibbles[2 * i + 1]);
+    }
+    return true;
+}
+
+// Reads the last block of a seekable hex stream and seeks back to where it was.
+// Streams that cannot seek (pipes) return false and are checked only at their end.
+bool readHexTailBlock(istream& in, unsigned char (&block)[BLOCK_SIZE]){
+    constexpr streamoff TAIL_WINDOW = 4096; // room for trailing whitespace
+    streampos position = in.tellg();
+    if(position == streampos(-1)) return false;
+    in.seekg(0, ios::end);
+    streampos end = in.tellg();
+    bool found = false;
+    if(in && end != streampos(-1)){
+        streamoff window = min<streamoff>(end - position, TAIL_WINDOW);
+        vector<char> tail((size_t)window);
+        in.seekg(end - window);
+        readChunk(in, tail.data(), tail.size());
+        found = in && lastHexBlock(tail.data(), tail.size(), block);
+    }
+    in.clear();
+    in.seekg(position);
+    return found;
+}
+
+// Reads a container or hex ciphertext from in and writes the plaintext to out chunk by chunk
+bool decryptStream(istream& in, ostream& out, const KeySchedule& schedule, bool& validKey){
+    validKey = false;
+    vector<unsigned char> pending;
+    pending.reserve(STREAM_CHUNK_BYTES + MAX_BLOCK_SIZE);
+    uint64_t written = 0;
+    
+    unsigned char prefix[CONTAINER_MAX_HEADER_SIZE];
+    in.read((char*)prefix, sizeof(prefix));
+    size_t prefixLength = min((size_t)in.gcount(), sizeof(prefix));
+    ContainerHeader header;
+    bool hasHeader = decodeContainerHeader(prefix, prefixLength, header);
+    if(hasHeader && !supportedContainer(header)) return false;
+    // The container decides the block variant; hex text is always 8-byte blocks
+    const KeySchedule blocks = schedule.withBlockSize(hasHeader ? header.blockSize : BLOCK_SIZE);
+    
+    if(hasHeader){
+        // A wrong key is rejected before any block is decrypted
+        if(header.keyCheck != keyCheckValue(schedule)) return true;
+        // Bytes read past the header already belong to the ciphertext
+        size_t headerSize = containerHeaderSize(header);
+        if(prefixLength > headerSize) pending.insert(pending.end(), prefix + headerSize, prefix + prefixLength);
+        if(header.mode == MODE_CTR){
+            return decryptCtrStream(in, out, blocks, header, pending, validKey);
+        }
+        
+        while(in){
+            size_t used = pending.size();
+            pending.resize(used + STREAM_CHUNK_BYTES);
+            readChunk(in, pending.data() + used, STREAM_CHUNK_BYTES);
+            pending.resize(used + (size_t)in.gcount());
+            if(!flushCiphertext(pending, out, blocks, written)) return false;
+        }
+    } else {
+        // Hex text has no key check value, so the padding of its last block is checked
+        // before anything is decrypted. A prefix that hit end of input is the whole text.
+        unsigned char tail[BLOCK_SIZE];
+        bool wholeText = !in;
+        if(wholeText ? lastHexBlock((const char*)prefix, prefixLength, tail) : readHexTailBlock(in, tail)){
+            checkTailBlock(Span<const uint8_t>(tail, BLOCK_SIZE), blocks, validKey);
+            if(!validKey) return true;
+            validKey = false;
+        }
+        if(!wholeText && !in){
+            cout << "Error: Could not read input." << endl;
+            return false;
+        }
+
+        vector<char> text(prefix, prefix + prefixLength);
+        HexDecodeState hexState;
+        uint64_t errorOffset = 0;
+        do {
+            size_t used = pending.size();
+            size_t decoded = 0;
+            pending.resize(used + (text.size() + 1) / 2);
+            HexStatus status;
+            {
+                BITCASCADE_TIME_PHASE(PHASE_HEX_DECODE);
+                BITCASCADE_ADD_BYTES(PHASE_HEX_DECODE, text.size());
+                status = hexDecodeChunk(text.data(), text.size(), pending.data() + used, decoded, hexState, errorOffset);
+            }
+            pending.resize(used + decoded);
+            if(!reportHexError(status, errorOffset)) return false;
+            if(!flushCiphertext(pending, out, blocks, written)) return false;
+            text.resize(STREAM_CHUNK_BYTES);
+            readChunk(in, text.data(), text.size());
+            text.resize((size_t)in.gcount());
+        } while(!text.empty());
+        if(hexState.highNibble >= 0) return reportHexError(HEX_ODD_LENGTH, hexState.offset);
+    }
+    if(in.bad()){
+        cout << "Error: Could not read input." << endl;
+        return false;
+    }
+    
+    if(!finishCiphertext(pending, out, blocks, validKey, written)) return false;
+    if(hasHeader && validKey && written != header.originalLength){
+        cout << "Error: Decrypted length does not match the container header." << endl;
+        return false;
+    }
+    return true;
+}
+
+// ===================== MEMORY-MAPPED FILE ENCRYPTION =====================
+// The input file and a pre-sized output file are both mapped, and the block engine
+// reads and writes the mappings directly. Only the tail block is copied through a
+// local buffer for padding. Needs a binary container on both ends. The output is
+// flushed with msync before success is reported; on failure it is deleted if this call
+// created it.
+
+#ifdef BITCASCADE_MMAP
+
+struct MappedFile {
+    int fd = -1;
+    unsigned char* data = nullptr;
+    size_t size = 0;
+    string removeOnClose; // output file that is deleted unless finishOutputFile succeeds
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile(){
+        if(data) munmap(data, size);
+        if(fd >= 0) close(fd);
+        if(!removeOnClose.empty()) unlink(removeOnClose.c_str());
+    }
+};
+
+bool mapInputFile(const string& filename, MappedFile& file){
+    file.fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if(file.fd < 0 || fstat(file.fd, &info) != 0){
+        cout << "Error: Could not open file for reading." << endl;
+        return false;
+    }
+    file.size = (size_t)info.st_size;
+    if(file.size == 0) return true;
+    void* data = mmap(nullptr, file.size, PROT_READ, MAP_SHARED, file.fd, 0);
+    if(data == MAP_FAILED){
+        cout << "Error: Could not map " << filename << " into memory." << endl;
+        return false;
+    }
+    file.data = (unsigned char*)data;
+    madvise(file.data, file.size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool mapOutputFile(const string& filename, size_t size, MappedFile& file){
+    bool created = !fileExists(filename);
+    file.fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(file.fd < 0){
+        cout << "Error: Could not open file for writing." << endl;
+        return false;
+    }
+    if(created) file.removeOnClose = filename;
+    if(ftruncate(file.fd, (off_t)size) != 0){
+        cout << "Error: Could not open file for writing." << endl;
+        return false;
+    }
+    file.size = size;
+    if(size == 0) return true;
+#ifndef __APPLE__
+    // Allocate the blocks up front: a full disk fails here instead of raising SIGBUS on a store
+    int error = posix_fallocate(file.fd, 0, (off_t)size);
+    if(error != 0){
+        cout << "Error: Could not allocate " << size << " bytes for " << filename << ": " << strerror(error) << "." << endl;
+        return false;
+    }
+#endif
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+    if(data == MAP_FAILED){
+        cout << "Error: Could not map " << filename << " into memory." << endl;
+        return false;
+    }
+    file.data = (unsigned char*)data;
+    return true;
+}
+
+// Flushes a mapped output file to disk and closes it; it is kept only if every step succeeds
+bool finishOutputFile(MappedFile& file){
+    bool ok = !file.data || msync(file.data, file.size, MS_SYNC) == 0;
+    if(file.data && munmap(file.data, file.size) != 0) ok = false;
+    file.data = nullptr;
+    if(close(file.fd) != 0) ok = false;
+    file.fd = -1;
+    if(!ok){
+        cout << "Error: Could not write " << file.removeOnClose << ": " << strerror(errno) << "." << endl;
+        return false;
+    }
+    file.removeOnClose.clear();
+    return true;
+}
+
+bool encryptFileMapped(const string& inputName, const string& outputName, const KeySchedule& schedule, ContainerMode mode){
+    MappedFile input, output;
+    if(!mapInputFile(inputName, input)) return false;
+    
+    ContainerHeader header = makeContainerHeader(input.size, schedule, mode);
+    size_t headerSize = containerHeaderSize(header);
+    if(!mapOutputFile(outputName, headerSize + containerPayloadLength(header), output)) return false;
+    
+    unsigned char encoded[CONTAINER_MAX_HEADER_SIZE];
+    memcpy(output.data, encoded, encodeContainerHeader(header, encoded));
+    
+    Span<const uint8_t> plaintext(input.data, input.size);
+    Span<uint8_t> ciphertext(output.data + headerSize, output.size - headerSize);
+    if(mode == MODE_CTR){
+        ctrCrypt(plaintext, ciphertext, schedule, header.nonce);
+    } else {
+        encryptInto(plaintext, ciphertext, schedule);
+    }
+    return finishOutputFile(output);
+}
+
+bool decryptFileMapped(const string& inputName, const string& outputName, const KeySchedule& schedule, bool& validKey){
+    validKey = false;
+    MappedFile input;
+    if(!mapInputFile(inputName, input)) return false;
+    
+    ContainerHeader header;
+    if(!decodeContainerHeader(input.data, input.size, header)){
+        cout << "Error: Memory-mapped decryption needs a binary ciphertext container." << endl;
+        return false;
+    }
+    if(!supportedContainer(header)) return false;
+    const size_t blockSize = header.blockSize;
+    const size_t headerSize = containerHeaderSize(header);
+    // Checked before fullBlocks and the tail pointer are derived from the original length
+    if(!containerLengthMatches(header, input.size - headerSize)){
+        cout << "Error: Ciphertext length does not match the container header." << endl;
+        return false;
+    }
+    if(header.keyCheck != keyCheckValue(schedule)) return true;
+    const KeySchedule blocks = schedule.withBlockSize(header.blockSize);
+    const unsigned char* ciphertext = input.data + headerSize;
+    
+    if(header.mode == MODE_CTR){
+        validKey = true;
+        MappedFile output;
+        if(!mapOutputFile(outputName, header.originalLength, output)) return false;
+        ctrCrypt(Span<const uint8_t>(ciphertext, header.originalLength), Span<uint8_t>(output.data, output.size), blocks, header.nonce);
+        return finishOutputFile(output);
+    }
+    
+    // Check the padding of the tail block before writing anything
+    size_t fullBlocks = header.originalLength / blockSize;
+    size_t leftover = header.originalLength % blockSize;
+    unsigned char tail[MAX_BLOCK_SIZE];
+    blockVariant(blocks).decrypt(ciphertext + fullBlocks * blockSize, tail, 1, blocks);
+    if(paddingLength(tail, blockSize) != blockSize - leftover) return true;
+    validKey = true;
+    
+    MappedFile output;
+    if(!mapOutputFile(outputName, header.originalLength, output)) return false;
+    parallelDecryptBlocks(ciphertext, output.data, fullBlocks, blocks);
+    if(leftover > 0) memcpy(output.data + fullBlocks * blockSize, tail, leftover);
+    return finishOutputFile(output);
+}
+
+#endif // BITCASCADE_MMAP
+
+// Encrypts a file with the mapped path when asked for (and available), otherwise streams it
+bool encryptFile(const string& inputName, const string& outputName, const KeySchedule& schedule, const FileOptions& options){
+    if(!distinctOutputFile(inputName, outputName)) return false;
+#ifdef BITCASCADE_MMAP
+    if(options.mapped && !options.hexOutput){
+        return encryptFileMapped(inputName, outputName, schedule, options.mode);
+    }
+#endif
+    ifstream input(inputName, ios::binary);
+    if(!input.is_open()){
+        cout << "Error: Could not open file for reading." << endl;
+        return false;
+    }
+    bool created = !fileExists(outputName);
+    bool ok;
+    {
+        ofstream output(outputName, ios::binary | ios::trunc);
+        if(!output.is_open()){
+            cout << "Error: Could not open file for writing." << endl;
+            return false;
+        }
+        ok = encryptStream(input, output, schedule, options.hexOutput, options.mode);
+    }
+    if(!ok && created) remove(outputName.c_str());
+    return ok;
+}
+
+bool decryptFile(const string& inputName, const string& outputName, const KeySchedule& schedule, bool& validKey,
+                 const FileOptions& options){
+    validKey = false;
+    if(!distinctOutputFile(inputName, outputName)) return false;
+#ifdef BITCASCADE_MMAP
+    // The mapped path deletes its own output on failure and creates none for a wrong key
+    if(options.mapped){
+        return decryptFileMapped(inputName, outputName, schedule, validKey) && validKey;
+    }
+#endif
+    bool created = !fileExists(outputName);
+    bool ok;
+    {
+        ifstream input(inputName, ios::binary);
+        if(!input.is_open()){
+            cout << "Could not read file: " << inputName << endl;
+            return false;
+        }
+        ofstream output(outputName, ios::binary | ios::trunc);
+        if(!output.is_open()){
+            cout << "Error: Could not open file for writing." << endl;
+            return false;
+        }
+        ok = decryptStream(input, output, schedule, validKey);
+    }
+    if(!ok || !validKey){
+        if(created) remove(outputName.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ===================== RANDOM-ACCESS DECRYPTION =====================
+// Blocks are independent and CTR can seek, so a byte range is decrypted from the
+// header plus one positional read of the ciphertext that covers it.
+
+#ifdef BITCASCADE_MMAP
+
+struct RandomAccessFile {
+    int fd = -1;
+
+    RandomAccessFile() = default;
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+    ~RandomAccessFile(){
+        if(fd >= 0) close(fd);
+    }
+
+    bool open(const string& filename){
+        fd = ::open(filename.c_str(), O_RDONLY);
+        return fd >= 0;
+    }
+
+    uint64_t size() const {
+        struct stat info;
+        return fstat(fd, &info) == 0 ? (uint64_t)info.st_size : 0;
+    }
+
+    bool readAt(uint64_t offset, unsigned char* data, size_t length){
+        BITCASCADE_TIME_PHASE(PHASE_READ_FILE);
+        BITCASCADE_ADD_BYTES(PHASE_READ_FILE, length);
+        while(length > 0){
+            ssize_t got = pread(fd, data, length, (off_t)offset);
+            if(got < 0 && errno == EINTR) continue;
+            if(got <= 0) return false;
+            data += got;
+            offset += (uint64_t)got;
+            length -= (size_t)got;
+        }
+        return true;
+    }
+};
+
+#else
+
+struct RandomAccessFile {
+    ifstream file;
+
+    bool open(const string& filename){
+        file.open(filename, ios::binary);
+        return file.is_open();
+    }
+
+    uint64_t size(){
+        file.seekg(0, ios::end);
+        return (uint64_t)file.tellg();
+    }
+
+    bool readAt(uint64_t offset, unsigned char* data, size_t length){
+        BITCASCADE_TIME_PHASE(PHASE_READ_FILE);
+        BITCASCADE_ADD_BYTES(PHASE_READ_FILE, length);
+        file.clear();
+        file.seekg((streamoff)offset);
+        file.read((char*)data, (streamsize)length);
+        return (size_t)file.gcount() == length;
+    }
+};
+
+#endif // BITCASCADE_MMAP
+
+bool decryptFileRange(const string& inputName, uint64_t offset, uint64_t length, vector<unsigned char>& plaintext,
+                      const KeySchedule& schedule, bool& validKey){
+    validKey = false;
+    plaintext.clear();
+    RandomAccessFile file;
+    if(!file.open(inputName)){
+        cout << "Error: Could not open file for reading." << endl;
+        return false;
+    }
+    
+    uint64_t fileLength = file.size();
+    unsigned char prefix[CONTAINER_MAX_HEADER_SIZE];
+    size_t prefixLength = (size_t)min<uint64_t>(fileLength, sizeof(prefix));
+    ContainerHeader header;
+    if(!file.readAt(0, prefix, prefixLength) || !decodeContainerHeader(prefix, prefixLength, header)){
+        cout << "Error: Range decryption needs a binary ciphertext container." << endl;
+        return false;
+    }
+    if(!supportedContainer(header)) return false;
+    const uint64_t headerSize = containerHeaderSize(header);
+    if(!containerLengthMatches(header, fileLength - headerSize)){
+        cout << "Error: Ciphertext length does not match the container header." << endl;
+        return false;
+    }
+    if(header.keyCheck != keyCheckValue(schedule)) return true;
+    const KeySchedule blocks = schedule.withBlockSize(header.blockSize);
+    
+    uint64_t begin = min(offset, header.originalLength);
+    uint64_t end = begin + min(length, header.originalLength - begin);
+    if(header.mode == MODE_CTR){
+        plaintext.resize((size_t)(end - begin));
+        if(!file.readAt(headerSize + begin, plaintext.data(), plaintext.size())){
+            cout << "Error: Could not read input." << endl;
+            return false;
+        }
+        ctrCrypt(plaintext, plaintext, blocks, header.nonce, begin);
+        validKey = true;
+        return true;
+    }
+    
+    // The block holding the padding is only read when the range reaches the end
+    const uint64_t blockSize = header.blockSize;
+    const uint64_t paddingBlock = header.originalLength / blockSize;
+    bool reachesEnd = end == header.originalLength;
+    if(begin == end && !reachesEnd){
+        validKey = true;
+        return true;
+    }
+    uint64_t firstBlock = begin / blockSize;
+    uint64_t endBlock = reachesEnd ? paddingBlock + 1 : (end + blockSize - 1) / blockSize;
+    size_t blockCount = (size_t)(endBlock - firstBlock);
+    
+    plaintext.resize(blockCount * blockSize);
+    if(!file.readAt(headerSize + firstBlock * blockSize, plaintext.data(), plaintext.size())){
+        cout << "Error: Could not read input." << endl;
+        return false;
+    }
+    parallelDecryptBlocks(plaintext.data(), plaintext.data(), blockCount, blocks);
+    
+    if(reachesEnd){
+        const unsigned char* tail = plaintext.data() + (blockCount - 1) * blockSize;
+        if(paddingLength(tail, blockSize) != blockSize - header.originalLength % blockSize){
+            plaintext.clear();
+            return true;
+        }
+    }
+    validKey = true;
+    plaintext.erase(plaintext.begin(), plaintext.begin() + (size_t)(begin - firstBlock * blockSize));
+    plaintext.resize((size_t)(end - begin));
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+// Hot-path instrumentation: per-phase call counts, nanoseconds and bytes, plus heap
+// allocation counts, kept per thread and summed on demand by collectStats().
+//
+// Everything is compiled in only when the library is built with -DBITCASCADE_STATS.
+// Without it the macros below expand to nothing, operator new is not replaced, and
+// collectStats() returns zeros, so release builds pay nothing.
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <chrono>
+
+enum StatPhase {
+    PHASE_READ_FILE,      // reading plaintext or ciphertext files
+    PHASE_HEX_DECODE,     // hex text to bytes
+    PHASE_HEX_ENCODE,     // bytes to hex text
+    PHASE_KEY_EXPANSION,  // KeySchedule construction
+    PHASE_ENCRYPT_BLOCKS, // bulk ECB encryption (all threads of one call)
+    PHASE_DECRYPT_BLOCKS, // bulk ECB decryption
+    PHASE_PADDING_CHECK,  // PKCS7 padding checks of the tail block
+    PHASE_CTR,            // CTR keystream generation and XOR
+    PHASE_WRITE_FILE,     // writing plaintext or ciphertext files
+    PHASE_COUNT
+};
+
+// Short name used in the JSON keys and the text table
+const char* statPhaseName(StatPhase phase);
+
+struct PhaseStats {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+};
+
+struct StatsSnapshot {
+    PhaseStats phases[PHASE_COUNT];
+    uint64_t allocations = 0;    // operator new calls
+    uint64_t allocatedBytes = 0;
+};
+
+// True when the library was built with BITCASCADE_STATS
+bool statsCompiledIn();
+
+// Sum of the counters of every live thread and of every thread that has exited
+StatsSnapshot collectStats();
+void resetStats();
+
+// Human-readable table, or one JSON object when json is true
+std::string formatStats(const StatsSnapshot& stats, bool json);
+
+// Adds to the calling thread's counters
+void recordPhase(StatPhase phase, uint64_t nanoseconds);
+void recordBytes(StatPhase phase, uint64_t bytes);
+
+// Times the enclosing scope as one call of a phase
+class PhaseTimer {
+public:
+    explicit PhaseTimer(StatPhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer(){
+        recordPhase(phase, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count());
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    StatPhase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifdef BITCASCADE_STATS
+#define BITCASCADE_TIME_PHASE(phase) PhaseTimer bitcascadePhaseTimer(phase)
+#define BITCASCADE_ADD_BYTES(phase, bytes) recordBytes(phase, bytes)
+#else
+#define BITCASCADE_TIME_PHASE(phase) ((void)0)
+#define BITCASCADE_ADD_BYTES(phase, bytes) ((void)0)
+#endif
@@ -0,0 +1,201 @@
+// Client for the BitCascade daemon (daemon.cpp): encrypts or decrypts standard input
+// through the daemon, or measures the round-trip latency of short requests.
+// Data goes to standard output, so messages are written to standard error.
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include "daemon_protocol.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define BITCASCADE_UNIX_SOCKETS 1
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SIGPIPE stays at its default
+#endif
+#endif
+using namespace std;
+
+#ifdef BITCASCADE_UNIX_SOCKETS
+
+int connectDaemon(const string& socketPath){
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)){
+        cerr << "Error: Socket path must be 1.." << sizeof(address.sun_path) - 1 << " characters." << endl;
+        return -1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) != 0){
+        cerr << "Error: Could not connect to " << socketPath << ": " << strerror(errno) << endl;
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const char* data, size_t length){
+    while(length > 0){
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR) continue;
+        if(sent <= 0) return false;
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+bool receiveAll(int fd, char* data, size_t length){
+    while(length > 0){
+        ssize_t got = recv(fd, data, length, 0);
+        if(got < 0 && errno == EINTR) continue;
+        if(got <= 0) return false;
+        data += got;
+        length -= (size_t)got;
+    }
+    return true;
+}
+
+// Sends one request and waits for its response; false on a connection or framing error
+bool daemonRequest(int fd, DaemonOperation operation, unsigned blockSize, const string& key,
+                   const string& payload, DaemonStatus& status, string& response){
+    string frame;
+    frame.reserve(DAEMON_LENGTH_SIZE + DAEMON_REQUEST_HEADER_SIZE + key.size() + payload.size());
+    encodeDaemonRequest(frame, operation, blockSize, key, payload.size());
+    frame += payload;
+    if(!sendAll(fd, frame.data(), frame.size())) return false;
+
+    unsigned char header[DAEMON_LENGTH_SIZE + 1];
+    if(!receiveAll(fd, (char*)header, sizeof(header))) return false;
+    uint32_t bodyLength = loadLittleEndian32(header);
+    if(bodyLength == 0 || bodyLength - 1 > DAEMON_MAX_BODY) return false;
+    status = (DaemonStatus)header[DAEMON_LENGTH_SIZE];
+    response.resize(bodyLength - 1);
+    return response.empty() || receiveAll(fd, &response[0], response.size());
+}
+
+const char* statusMessage(DaemonStatus status){
+    switch(status){
+        case DAEMON_OK: return "ok";
+        case DAEMON_BAD_REQUEST: return "bad request";
+        case DAEMON_WRONG_KEY: return "wrong key or corrupted data";
+    }
+    return "unknown status";
+}
+
+int runCrypt(const string& socketPath, DaemonOperation operation, unsigned blockSize, const string& key){
+    if(key.empty() || key.size() > DAEMON_MAX_KEY_LENGTH){
+        cerr << "Error: Key must be 1.." << DAEMON_MAX_KEY_LENGTH << " bytes." << endl;
+        return 1;
+    }
+    stringstream input;
+    input << cin.rdbuf();
+    string payload = input.str();
+    if(payload.size() > DAEMON_MAX_BODY - DAEMON_REQUEST_HEADER_SIZE - key.size()){
+        cerr << "Error: Input is larger than the daemon accepts." << endl;
+        return 1;
+    }
+
+    int fd = connectDaemon(socketPath);
+    if(fd < 0) return 1;
+    DaemonStatus status;
+    string response;
+    bool ok = daemonRequest(fd, operation, blockSize, key, payload, status, response);
+    close(fd);
+    if(!ok){
+        cerr << "Error: Connection to the daemon failed." << endl;
+        return 1;
+    }
+    if(status != DAEMON_OK){
+        cerr << "Error: " << statusMessage(status) << endl;
+        return 1;
+    }
+    cout.write(response.data(), (streamsize)response.size());
+    return cout ? 0 : 1;
+}
+
+// Round trips of encrypt requests on one connection, one at a time
+int runBenchmark(const string& socketPath, unsigned blockSize, size_t count, size_t size){
+    int fd = connectDaemon(socketPath);
+    if(fd < 0) return 1;
+    const string key = "benchmark-key";
+    string payload(size, 'x');
+    string response, decrypted;
+    DaemonStatus status;
+
+    // The first request also checks that a round trip gives the plaintext back
+    if(!daemonRequest(fd, DAEMON_ENCRYPT, blockSize, key, payload, status, response) || status != DAEMON_OK ||
+       !daemonRequest(fd, DAEMON_DECRYPT, blockSize, key, response, status, decrypted) || status != DAEMON_OK ||
+       decrypted != payload){
+        cerr << "Error: Round trip through the daemon failed." << endl;
+        close(fd);
+        return 1;
+    }
+
+    vector<double> micros;
+    micros.reserve(count);
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++){
+        auto requestStart = chrono::steady_clock::now();
+        if(!daemonRequest(fd, DAEMON_ENCRYPT, blockSize, key, payload, status, response) || status != DAEMON_OK){
+            cerr << "Error: Request " << i << " failed." << endl;
+            close(fd);
+            return 1;
+        }
+        micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - requestStart).count());
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    close(fd);
+
+    sort(micros.begin(), micros.end());
+    auto percentile = [&](double p){ return micros[min(micros.size() - 1, (size_t)(p * micros.size()))]; };
+    cerr << fixed << setprecision(1) << count << " requests of " << size << " bytes: "
+         << count / seconds << " requests/s, p50 " << percentile(0.50) << " us, p99 " << percentile(0.99)
+         << " us, max " << micros.back() << " us" << endl;
+    return 0;
+}
+
+#endif // BITCASCADE_UNIX_SOCKETS
+
+int main(int argc, char* argv[]){
+    string socketPath = "bitcascade.sock";
+    unsigned blockSize = 8;
+    size_t benchCount = 0, benchSize = 64;
+    vector<string> positional;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "--socket" && i + 1 < argc){
+            socketPath = argv[++i];
+        } else if(arg == "--block-size" && i + 1 < argc){
+            blockSize = (unsigned)atoi(argv[++i]);
+        } else if(arg == "--bench" && i + 1 < argc){
+            benchCount = max<size_t>(1, (size_t)atoll(argv[++i]));
+        } else if(arg == "--size" && i + 1 < argc){
+            benchSize = (size_t)atoll(argv[++i]);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    bool crypt = positional.size() == 2 && (positional[0] == "encrypt" || positional[0] == "decrypt");
+    if(benchCount == 0 && !crypt){
+        cerr << "Usage: " << argv[0] << " [--socket PATH] [--block-size 8|16|32|64] encrypt|decrypt KEY < input > output" << endl;
+        cerr << "       " << argv[0] << " [--socket PATH] [--block-size 8|16|32|64] --bench COUNT [--size BYTES]" << endl;
+        return 1;
+    }
+#ifdef BITCASCADE_UNIX_SOCKETS
+    if(benchCount > 0) return runBenchmark(socketPath, blockSize, benchCount, benchSize);
+    return runCrypt(socketPath, positional[0] == "encrypt" ? DAEMON_ENCRYPT : DAEMON_DECRYPT, blockSize, positional[1]);
+#else
+    cerr << "Error: The client needs Unix domain sockets." << endl;
+    return 1;
+#endif
+}
@@ -0,0 +1,98 @@
+#pragma once
+// BitCascade binary ciphertext container, shared by the CLI and the GUI.
+//
+// Layout (all integers little-endian):
+//   0  magic "BCAS"
+//   4  version         (1 byte)
+//   5  block size      (1 byte, bytes per block)
+//   6  rounds          (1 byte)
+//   7  mode            (1 byte, ContainerMode)
+//   8  original length (8 bytes, plaintext length before padding)
+//  16  key check value (4 bytes, first bytes of an all-zero block encrypted with the key)
+//  20  nonce           (8 bytes, MODE_CTR only)
+//  20/28 ciphertext    (MODE_ECB: padded blocks; MODE_CTR: exactly original length bytes)
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+const char CONTAINER_MAGIC[4] = {'B', 'C', 'A', 'S'};
+constexpr unsigned char CONTAINER_VERSION = 1;
+constexpr size_t CONTAINER_HEADER_SIZE = 20;
+constexpr size_t CONTAINER_NONCE_SIZE = 8;
+constexpr size_t CONTAINER_MAX_HEADER_SIZE = CONTAINER_HEADER_SIZE + CONTAINER_NONCE_SIZE;
+
+enum ContainerMode : unsigned char {
+    MODE_ECB = 0, // independent blocks, PKCS7 padding
+    MODE_CTR = 1, // data XORed with the encrypted nonce + block counter, no padding
+};
+
+struct ContainerHeader {
+    unsigned char version = CONTAINER_VERSION;
+    unsigned char blockSize = 0;
+    unsigned char rounds = 0;
+    unsigned char mode = MODE_ECB;
+    uint64_t originalLength = 0;
+    uint32_t keyCheck = 0;
+    uint64_t nonce = 0; // MODE_CTR only
+};
+
+// Bytes before the ciphertext: the fixed header plus the nonce in CTR mode
+inline size_t containerHeaderSize(const ContainerHeader& header){
+    return header.mode == MODE_CTR ? CONTAINER_MAX_HEADER_SIZE : CONTAINER_HEADER_SIZE;
+}
+
+inline bool hasContainerMagic(const unsigned char* data, size_t length){
+    return length >= sizeof(CONTAINER_MAGIC) && memcmp(data, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) == 0;
+}
+
+// Returns the number of bytes written, containerHeaderSize(header)
+inline size_t encodeContainerHeader(const ContainerHeader& header, unsigned char (&out)[CONTAINER_MAX_HEADER_SIZE]){
+    memcpy(out, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    out[4] = header.version;
+    out[5] = header.blockSize;
+    out[6] = header.rounds;
+    out[7] = header.mode;
+    for(int i = 0; i < 8; i++) out[8 + i] = (unsigned char)(header.originalLength >> (8 * i));
+    for(int i = 0; i < 4; i++) out[16 + i] = (unsigned char)(header.keyCheck >> (8 * i));
+    if(header.mode == MODE_CTR){
+        for(int i = 0; i < 8; i++) out[20 + i] = (unsigned char)(header.nonce >> (8 * i));
+    }
+    return containerHeaderSize(header);
+}
+
+// Returns false if the data does not start with a complete container header
+inline bool decodeContainerHeader(const unsigned char* data, size_t length, ContainerHeader& header){
+    if(length < CONTAINER_HEADER_SIZE || !hasContainerMagic(data, length)) return false;
+    header.version = data[4];
+    header.blockSize = data[5];
+    header.rounds = data[6];
+    header.mode = data[7];
+    header.originalLength = 0;
+    for(int i = 0; i < 8; i++) header.originalLength |= (uint64_t)data[8 + i] << (8 * i);
+    header.keyCheck = 0;
+    for(int i = 0; i < 4; i++) header.keyCheck |= (uint32_t)data[16 + i] << (8 * i);
+    header.nonce = 0;
+    if(header.mode == MODE_CTR){
+        if(length < CONTAINER_MAX_HEADER_SIZE) return false;
+        for(int i = 0; i < 8; i++) header.nonce |= (uint64_t)data[20 + i] << (8 * i);
+    }
+    return true;
+}
+
+// Ciphertext length for a plaintext of the given length (PKCS7 always adds 1..blockSize bytes).
+// Wraps around for lengths near UINT64_MAX, so header lengths go through containerLengthMatches.
+inline uint64_t paddedLength(uint64_t originalLength, unsigned blockSize){
+    return (originalLength / blockSize + 1) * blockSize;
+}
+
+// Ciphertext bytes that follow the header
+inline uint64_t containerPayloadLength(const ContainerHeader& header){
+    return header.mode == MODE_CTR ? header.originalLength : paddedLength(header.originalLength, header.blockSize);
+}
+
+// True if payloadBytes is exactly the ciphertext length the header's original length calls for.
+// The original length is bounded by the payload first, so a crafted length cannot wrap around.
+inline bool containerLengthMatches(const ContainerHeader& header, uint64_t payloadBytes){
+    if(header.blockSize == 0 || header.originalLength > payloadBytes) return false;
+    return containerPayloadLength(header) == payloadBytes;
+}
@@ -0,0 +1,332 @@
+// BitCascade daemon: a long-running encryption server on a Unix domain socket, so
+// local services can encrypt short messages without starting a process per request.
+// One epoll loop serves every connection; key schedules stay warm in sharedKeyCache()
+// and large payloads are split across the shared worker pool by the bulk engine.
+// The protocol is described in daemon_protocol.h; client.cpp is a matching client.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include "bitcascade.h"
+#include "daemon_protocol.h"
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+#ifdef __linux__
+
+constexpr int MAX_EVENTS = 64;
+constexpr size_t READ_CHUNK_BYTES = 64 * 1024;
+constexpr size_t OUTPUT_HIGH_WATER = 8 * 1024 * 1024; // stop reading a client that does not read its answers
+
+volatile sig_atomic_t stopRequested = 0;
+uint64_t requestsServed = 0;
+
+void requestStop(int){
+    stopRequested = 1;
+}
+
+// ===================== REQUESTS =====================
+
+void writeResponseHeader(char* out, DaemonStatus status, size_t payloadLength){
+    storeLittleEndian32((unsigned char*)out, (uint32_t)(1 + payloadLength));
+    out[DAEMON_LENGTH_SIZE] = (char)status;
+}
+
+void appendEmptyResponse(string& out, DaemonStatus status){
+    size_t start = out.size();
+    out.resize(start + DAEMON_LENGTH_SIZE + 1);
+    writeResponseHeader(&out[start], status, 0);
+}
+
+// Answers one request body; the result is encrypted or decrypted straight into out
+void handleRequest(const unsigned char* body, size_t length, string& out){
+    DaemonRequest request;
+    if(!decodeDaemonRequest(body, length, request) || !isSupportedBlockSize(request.blockSize) ||
+       (request.operation != DAEMON_ENCRYPT && request.operation != DAEMON_DECRYPT)){
+        appendEmptyResponse(out, DAEMON_BAD_REQUEST);
+        return;
+    }
+    shared_ptr<const KeySchedule> schedule = sharedKeyCache().get(request.key, request.blockSize);
+    Span<const uint8_t> payload(request.payload, request.payloadLength);
+    const size_t start = out.size();
+    const size_t payloadStart = start + DAEMON_LENGTH_SIZE + 1;
+
+    if(request.operation == DAEMON_ENCRYPT){
+        size_t encrypted = encryptedSize(request.payloadLength, request.blockSize);
+        out.resize(payloadStart + encrypted);
+        encryptInto(payload, Span<uint8_t>((uint8_t*)&out[payloadStart], encrypted), *schedule);
+        writeResponseHeader(&out[start], DAEMON_OK, encrypted);
+        return;
+    }
+
+    // decryptInto checks the tail block before it touches the rest
+    size_t capacity = request.payloadLength ? request.payloadLength - 1 : 0;
+    out.resize(payloadStart + capacity);
+    bool validKey = false;
+    size_t decrypted = decryptInto(payload, Span<uint8_t>((uint8_t*)&out[payloadStart], capacity), *schedule, validKey);
+    if(!validKey){
+        out.resize(start);
+        appendEmptyResponse(out, DAEMON_WRONG_KEY);
+        return;
+    }
+    out.resize(payloadStart + decrypted);
+    writeResponseHeader(&out[start], DAEMON_OK, decrypted);
+}
+
+// ===================== CONNECTIONS =====================
+// A connection buffers input until whole frames are available and answers them in
+// order. Responses are written as far as the socket accepts; the rest waits for EPOLLOUT.
+
+struct Connection {
+    int fd = -1;
+    vector<unsigned char> input;
+    size_t inputStart = 0; // first byte of input not yet consumed
+    string output;
+    size_t outputSent = 0;
+    bool closing = false;  // close once output is flushed
+    uint32_t events = EPOLLIN; // events registered with epoll
+
+    size_t pendingOutput() const { return output.size() - outputSent; }
+};
+
+// Answers every complete frame in the input buffer
+void answerFrames(Connection& connection){
+    vector<unsigned char>& input = connection.input;
+    while(input.size() - connection.inputStart >= DAEMON_LENGTH_SIZE){
+        const unsigned char* frame = input.data() + connection.inputStart;
+        size_t bodyLength = loadLittleEndian32(frame);
+        if(bodyLength > DAEMON_MAX_BODY){
+            appendEmptyResponse(connection.output, DAEMON_BAD_REQUEST);
+            connection.closing = true;
+            input.clear();
+            connection.inputStart = 0;
+            return;
+        }
+        if(input.size() - connection.inputStart - DAEMON_LENGTH_SIZE < bodyLength) break;
+        handleRequest(frame + DAEMON_LENGTH_SIZE, bodyLength, connection.output);
+        requestsServed++;
+        connection.inputStart += DAEMON_LENGTH_SIZE + bodyLength;
+    }
+    // Drop consumed frames once they make up most of the buffer
+    if(connection.inputStart == input.size()){
+        input.clear();
+        connection.inputStart = 0;
+    } else if(connection.inputStart > input.size() / 2){
+        input.erase(input.begin(), input.begin() + (ptrdiff_t)connection.inputStart);
+        connection.inputStart = 0;
+    }
+}
+
+// Reads what the socket has, answering frames chunk by chunk so the buffer stays about
+// one frame long; false when the connection failed
+bool readRequests(Connection& connection){
+    while(!connection.closing && connection.pendingOutput() < OUTPUT_HIGH_WATER){
+        size_t used = connection.input.size();
+        connection.input.resize(used + READ_CHUNK_BYTES);
+        ssize_t got = recv(connection.fd, connection.input.data() + used, READ_CHUNK_BYTES, 0);
+        connection.input.resize(used + (got > 0 ? (size_t)got : 0));
+        if(got > 0){
+            answerFrames(connection);
+        } else if(got == 0){
+            // The peer finished sending; the answers already queued are still written
+            connection.closing = true;
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK){
+            return true;
+        } else if(errno != EINTR){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends pending output; false when the connection failed
+bool writeResponses(Connection& connection){
+    while(connection.outputSent < connection.output.size()){
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.outputSent,
+                            connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+        if(sent > 0){
+            connection.outputSent += (size_t)sent;
+        } else if(sent < 0 && errno == EINTR){
+            continue;
+        } else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            return true;
+        } else {
+            return false;
+        }
+    }
+    connection.output.clear();
+    connection.outputSent = 0;
+    return true;
+}
+
+// ===================== EVENT LOOP =====================
+
+int openListener(const string& socketPath){
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)){
+        cout << "Error: Socket path must be 1.." << sizeof(address.sun_path) - 1 << " characters." << endl;
+        return -1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+    // A socket left behind by a previous run is replaced; any other file is not touched
+    struct stat info;
+    if(lstat(socketPath.c_str(), &info) == 0){
+        if(!S_ISSOCK(info.st_mode)){
+            cout << "Error: " << socketPath << " exists and is not a socket." << endl;
+            return -1;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listener < 0){
+        cout << "Error: Could not create socket: " << strerror(errno) << endl;
+        return -1;
+    }
+    // The socket is created with mode 0600, so no other user can connect to it even briefly
+    mode_t previousMask = umask(0177);
+    int bound = bind(listener, (const sockaddr*)&address, sizeof(address));
+    umask(previousMask);
+    if(bound != 0 || listen(listener, SOMAXCONN) != 0){
+        cout << "Error: Could not listen on " << socketPath << ": " << strerror(errno) << endl;
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+int runDaemon(const string& socketPath){
+    int listener = openListener(socketPath);
+    if(listener < 0) return 1;
+    int poller = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    if(poller < 0 || epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event) != 0){
+        cout << "Error: Could not set up epoll: " << strerror(errno) << endl;
+        close(listener);
+        unlink(socketPath.c_str());
+        return 1;
+    }
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    signal(SIGPIPE, SIG_IGN);
+    // Start the pool workers now rather than on the first large request
+    sharedPool();
+    cout << "Listening on " << socketPath << " (backend " << blockBackend().name << ", "
+         << sharedPool().threadCount() << " threads)" << endl;
+
+    map<int, unique_ptr<Connection>> connections;
+    auto closeConnection = [&](int fd){
+        epoll_ctl(poller, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    };
+
+    epoll_event events[MAX_EVENTS];
+    while(!stopRequested){
+        int ready = epoll_wait(poller, events, MAX_EVENTS, -1);
+        if(ready < 0){
+            if(errno == EINTR) continue;
+            cout << "Error: epoll_wait failed: " << strerror(errno) << endl;
+            break;
+        }
+        for(int i = 0; i < ready; i++){
+            int fd = events[i].data.fd;
+            if(fd == listener){
+                int client;
+                while((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0){
+                    epoll_event clientEvent;
+                    memset(&clientEvent, 0, sizeof(clientEvent));
+                    clientEvent.events = EPOLLIN;
+                    clientEvent.data.fd = client;
+                    if(epoll_ctl(poller, EPOLL_CTL_ADD, client, &clientEvent) != 0){
+                        close(client);
+                        continue;
+                    }
+                    unique_ptr<Connection> connection(new Connection());
+                    connection->fd = client;
+                    connections[client] = move(connection);
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if(found == connections.end()) continue;
+            Connection& connection = *found->second;
+            bool ok = true;
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ok = readRequests(connection);
+            if(ok) ok = writeResponses(connection);
+            if(!ok || (connection.closing && connection.output.empty())){
+                closeConnection(fd);
+                continue;
+            }
+            // Wait for EPOLLOUT only while answers are pending, and stop reading while
+            // too many are
+            uint32_t wanted = 0;
+            if(!connection.closing && connection.pendingOutput() < OUTPUT_HIGH_WATER) wanted |= EPOLLIN;
+            if(connection.pendingOutput() > 0) wanted |= EPOLLOUT;
+            if(wanted != connection.events){
+                epoll_event update;
+                memset(&update, 0, sizeof(update));
+                update.events = wanted;
+                update.data.fd = fd;
+                epoll_ctl(poller, EPOLL_CTL_MOD, fd, &update);
+                connection.events = wanted;
+            }
+        }
+    }
+
+    for(auto& connection : connections) close(connection.first);
+    close(poller);
+    close(listener);
+    unlink(socketPath.c_str());
+    KeyScheduleCache::Counters cache = sharedKeyCache().counters();
+    cout << "Stopped after " << requestsServed << " requests (key cache: " << cache.hits << " hits, "
+         << cache.misses << " misses, " << cache.evictions << " evictions)" << endl;
+    return 0;
+}
+
+#endif // __linux__
+
+int main(int argc, char* argv[]){
+    string socketPath = "bitcascade.sock";
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "--socket" && i + 1 < argc){
+            socketPath = argv[++i];
+        } else if(arg == "--backend" && i + 1 < argc){
+            if(!selectBackend(argv[++i])){
+                cout << "Error: Backend " << argv[i] << " is not available." << endl;
+                return 1;
+            }
+        } else if(arg == "--threads" && i + 1 < argc){
+            setSharedPoolThreads((unsigned)atoi(argv[++i]));
+        } else {
+            cout << "Usage: " << argv[0] << " [--socket PATH] [--backend NAME] [--threads N]" << endl;
+            return 1;
+        }
+    }
+#ifdef __linux__
+    return runDaemon(socketPath);
+#else
+    cout << "Error: The daemon needs Linux (epoll)." << endl;
+    return 1;
+#endif
+}
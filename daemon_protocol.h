@@ -0,0 +1,79 @@
+#pragma once
+// Wire protocol between the BitCascade daemon (daemon.cpp) and its clients, over a
+// Unix domain stream socket. Every message is one frame; a connection may send any
+// number of requests and receives the responses in the same order.
+//
+// Request frame (all integers little-endian):
+//   0  body length  (4 bytes, bytes after this field)
+//   4  operation    (1 byte, DaemonOperation)
+//   5  block size   (1 byte, 8/16/32/64)
+//   6  key length   (2 bytes, 1..DAEMON_MAX_KEY_LENGTH)
+//   8  key
+//   8+key length    payload (plaintext to encrypt, or ECB ciphertext to decrypt)
+//
+// Response frame:
+//   0  body length  (4 bytes)
+//   4  status       (1 byte, DaemonStatus)
+//   5  payload      (padded ECB ciphertext, or the plaintext; empty unless DAEMON_OK)
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+constexpr size_t DAEMON_LENGTH_SIZE = 4;
+constexpr size_t DAEMON_REQUEST_HEADER_SIZE = 4; // operation, block size, key length
+constexpr size_t DAEMON_MAX_KEY_LENGTH = 1024;
+constexpr size_t DAEMON_MAX_BODY = 64 * 1024 * 1024; // larger frames are rejected and the connection closed
+
+enum DaemonOperation : unsigned char {
+    DAEMON_ENCRYPT = 1,
+    DAEMON_DECRYPT = 2,
+};
+
+enum DaemonStatus : unsigned char {
+    DAEMON_OK = 0,
+    DAEMON_BAD_REQUEST = 1, // malformed frame, unknown operation, block size or key length
+    DAEMON_WRONG_KEY = 2,   // ciphertext length or padding does not match the key
+};
+
+struct DaemonRequest {
+    DaemonOperation operation = DAEMON_ENCRYPT;
+    unsigned blockSize = 8;
+    std::string key;
+    const unsigned char* payload = nullptr;
+    size_t payloadLength = 0;
+};
+
+inline void storeLittleEndian32(unsigned char* out, uint32_t value){
+    for(int i = 0; i < 4; i++) out[i] = (unsigned char)(value >> (8 * i));
+}
+
+inline uint32_t loadLittleEndian32(const unsigned char* in){
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+// Appends the frame header and key of a request; the payload follows it
+inline void encodeDaemonRequest(std::string& out, DaemonOperation operation, unsigned blockSize,
+                                const std::string& key, size_t payloadLength){
+    unsigned char header[DAEMON_LENGTH_SIZE + DAEMON_REQUEST_HEADER_SIZE];
+    storeLittleEndian32(header, (uint32_t)(DAEMON_REQUEST_HEADER_SIZE + key.size() + payloadLength));
+    header[4] = operation;
+    header[5] = (unsigned char)blockSize;
+    header[6] = (unsigned char)key.size();
+    header[7] = (unsigned char)(key.size() >> 8);
+    out.append((const char*)header, sizeof(header));
+    out += key;
+}
+
+// Parses a request body (the bytes after the length field). Fields are only range-checked
+// here; the caller validates the operation and block size.
+inline bool decodeDaemonRequest(const unsigned char* body, size_t length, DaemonRequest& request){
+    if(length < DAEMON_REQUEST_HEADER_SIZE) return false;
+    size_t keyLength = (size_t)body[2] | (size_t)body[3] << 8;
+    if(keyLength == 0 || keyLength > DAEMON_MAX_KEY_LENGTH || length - DAEMON_REQUEST_HEADER_SIZE < keyLength) return false;
+    request.operation = (DaemonOperation)body[0];
+    request.blockSize = body[1];
+    request.key.assign((const char*)body + DAEMON_REQUEST_HEADER_SIZE, keyLength);
+    request.payload = body + DAEMON_REQUEST_HEADER_SIZE + keyLength;
+    request.payloadLength = length - DAEMON_REQUEST_HEADER_SIZE - keyLength;
+    return true;
+}
@@ -4,162 +4,180 @@
 #include <iomanip>
 #include <vector>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdio>
+#include "bitcascade.h"
 using namespace std;
 
-const int BLOCK_SIZE = 8; 
-
-unsigned char rotateLeft(unsigned char byte, int n){
-    return (byte << n ) | (byte >> (8-n));
-}
-
-unsigned char rotateRight(unsigned char byte, int n){
-    return (byte >> n) | (byte << (8-n));
-}
+// ===================== TRABAJO EN SEGUNDO PLANO =====================
+// El cifrado corre en un hilo aparte, por trozos de JOB_CHUNK_BYTES. El hilo publica el
+// avance en contadores atómicos que el bucle de dibujo lee en cada cuadro, y se detiene
+// al terminar el trozo actual cuando se pide cancelar.
+
+constexpr size_t JOB_CHUNK_BYTES = 1024 * 1024;
+constexpr size_t TEXT_PREVIEW_CHARS = 100;   // caracteres visibles en las cajas de texto
+
+struct CryptoJob {
+    thread worker;
+    atomic<uint64_t> bytesDone{0};
+    atomic<bool> cancelRequested{false};
+    atomic<bool> finished{false};
+    uint64_t bytesTotal = 0;
+    bool encrypting = true;
+    sf::Clock clock;
+
+    // Resultados; solo se leen después de finished
+    bool cancelled = false;
+    bool validKey = false;
+    string error;
+    ContainerHeader header;
+    vector<unsigned char> encrypted;
+    string hex;
+    string decrypted;
+};
 
-vector<unsigned char> generateSubkey(const string& key, const vector<unsigned char>& block, int round){
-    vector<unsigned char> subkey;
-    for(int i = 0; i < BLOCK_SIZE; i++){
-        subkey.push_back((round + key[i % key.size()] + i * i) % 256);
+// Cifra text por trozos de bloques completos; el último bloque lleva el relleno
+void runEncryptJob(CryptoJob& job, const string& text, const KeySchedule& schedule) {
+    const unsigned char* in = (const unsigned char*)text.data();
+    const size_t blockSize = schedule.blockSize;
+    const size_t fullBytes = text.size() / blockSize * blockSize;
+    job.encrypted.resize(encryptedSize(text.size(), blockSize));
+    for (size_t pos = 0; pos < fullBytes; pos += JOB_CHUNK_BYTES) {
+        if (job.cancelRequested) { job.cancelled = true; return; }
+        size_t length = min(JOB_CHUNK_BYTES, fullBytes - pos);
+        parallelEncryptBlocks(in + pos, job.encrypted.data() + pos, length / blockSize, schedule);
+        job.bytesDone = pos + length;
     }
-    return subkey;
+    encryptInto(Span<const uint8_t>(in + fullBytes, text.size() - fullBytes),
+                Span<uint8_t>(job.encrypted.data() + fullBytes, job.encrypted.size() - fullBytes), schedule);
+    job.hex.assign(job.encrypted.size() * 3, ' ');
+    hexEncodeSeparated(job.encrypted.data(), job.encrypted.size(), &job.hex[0], ' ');
+    job.bytesDone = text.size();
 }
 
-void confusion(vector<unsigned char> &block, const vector<unsigned char> &subkey, int round){
-    for(int i = 0; i < block.size(); i++){
-       int tmp = ((block[i] ^ subkey[i % subkey.size()]) + i * i + round * 7);
-        block[i] = (tmp % 256 + 256) % 256;
+// Descifra primero el último bloque (rechaza un relleno inválido al instante) y luego el resto por trozos
+void runDecryptJob(CryptoJob& job, const vector<unsigned char>& encrypted, const KeySchedule& schedule) {
+    const size_t blockSize = schedule.blockSize;
+    if (encrypted.empty() || encrypted.size() % blockSize != 0) return;
+    const size_t bodyBytes = encrypted.size() - blockSize;
+    unsigned char tail[MAX_BLOCK_SIZE];
+    size_t tailLength = decryptInto(Span<const uint8_t>(encrypted.data() + bodyBytes, blockSize),
+                                    Span<uint8_t>(tail, blockSize), schedule, job.validKey);
+    if (!job.validKey) return;
+
+    job.decrypted.resize(bodyBytes + tailLength);
+    unsigned char* out = (unsigned char*)&job.decrypted[0];
+    for (size_t pos = 0; pos < bodyBytes; pos += JOB_CHUNK_BYTES) {
+        if (job.cancelRequested) { job.cancelled = true; return; }
+        size_t length = min(JOB_CHUNK_BYTES, bodyBytes - pos);
+        parallelDecryptBlocks(encrypted.data() + pos, out + pos, length / blockSize, schedule);
+        job.bytesDone = pos + length;
     }
+    memcpy(out + bodyBytes, tail, tailLength);
+    job.bytesDone = encrypted.size();
 }
 
-void difusion(vector<unsigned char> &block){
-    for(int i = 0; i < block.size(); i++){
-        block[i] = rotateLeft(block[i], i + 1);
-    }
-    for(int i = 1; i < block.size(); i++){
-        block[i] ^= block[i - 1];
-    }
+// ===================== VISOR HEXADECIMAL =====================
+// Muestra el cifrado en filas de HEX_ROW_BYTES bytes precedidas por su desplazamiento.
+// Solo se formatean las filas visibles, así que desplazarse o dibujar cuesta lo mismo
+// con 16 bytes que con cientos de megabytes.
 
-    vector<unsigned char> temp(block.size());
-    for (int i = 0; i < block.size(); i++){
-        int j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
-        temp[j] = block[i];
-    }
-    block = temp;
-}
+constexpr size_t HEX_ROW_BYTES = 8;
+constexpr float HEX_SCROLLBAR_WIDTH = 8.f;
+constexpr int HEX_WHEEL_ROWS = 3; // filas por paso de la rueda del ratón
 
-void inverseDifusion(vector<unsigned char> &block){
-    vector<unsigned char> temp(block.size());
-    for (int i = 0; i < block.size(); i++){
-        int j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
-        temp[i] = block[j];
+class HexView {
+public:
+    void setup(const sf::Font& font, const sf::RectangleShape& box, unsigned characterSize) {
+        origin = box.getPosition();
+        size = box.getSize();
+        const float lineHeight = characterSize + 2.f;
+        rows.resize(max<size_t>(1, (size_t)((size.y - 10) / lineHeight)));
+        for (size_t r = 0; r < rows.size(); r++) {
+            rows[r].setFont(font);
+            rows[r].setCharacterSize(characterSize);
+            rows[r].setFillColor(sf::Color::Green);
+            rows[r].setPosition(origin.x + 10, origin.y + 5 + r * lineHeight);
+        }
+        track.setSize({HEX_SCROLLBAR_WIDTH, size.y});
+        track.setPosition(origin.x + size.x - HEX_SCROLLBAR_WIDTH, origin.y);
+        track.setFillColor(sf::Color(70, 70, 110));
+        thumb.setFillColor(sf::Color(160, 160, 200));
     }
 
-    for(int i = temp.size() - 1; i >= 1; i--){
-        temp[i] ^= temp[i - 1];
+    // bytes debe seguir vivo mientras se muestre; se vuelve a llamar cada vez que cambia
+    void setData(const vector<unsigned char>* bytes) {
+        data = bytes;
+        firstRow = 0;
+        layout();
     }
 
-    for(int i = 0; i < (int)temp.size(); i++){
-        temp[i] = rotateRight(temp[i], i + 1);
+    uint64_t rowCount() const {
+        return data ? (data->size() + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES : 0;
     }
-    block = temp;
-}
 
-void inverseConfusion(vector<unsigned char> &block, const vector<unsigned char> &subkey, int round){
-    for(int i = 0; i < block.size(); i++){
-        int tmp = (int)block[i] - (int)(i * i) - round * 7;
-        tmp = (tmp % 256 + 256) % 256;
-        block[i] = (unsigned char)(tmp ^ subkey[i % subkey.size()]);
-    }
-}
+    size_t visibleRows() const { return rows.size(); }
 
-vector<unsigned char> encryptBlock(vector<unsigned char> block, const string &key){
-    for(int round = 0; round < 5; round++){
-        vector<unsigned char> subkey = generateSubkey(key, block, round);
-        confusion(block, subkey, round);
-        difusion(block);
-    }
-    return block;
-}
-
-vector<unsigned char> decryptBlock(vector<unsigned char> block, const string &key){
-    for(int round = 4; round >= 0; round--){
-        vector<unsigned char> subkey = generateSubkey(key, block, round);
-        inverseDifusion(block);
-        inverseConfusion(block, subkey, round);
+    // Devuelve true si cambiaron las filas visibles
+    bool scrollBy(int64_t delta) {
+        uint64_t lastFirst = rowCount() > rows.size() ? rowCount() - rows.size() : 0;
+        uint64_t target = delta < 0 ? firstRow - min(firstRow, (uint64_t)-delta)
+                                    : firstRow + min(lastFirst - min(lastFirst, firstRow), (uint64_t)delta);
+        if (target == firstRow) return false;
+        firstRow = target;
+        layout();
+        return true;
     }
-    return block;
-}
 
-vector<unsigned char> padBlock(const vector<unsigned char>& data){
-    vector<unsigned char> padded = data;
-    int padding = BLOCK_SIZE - (data.size() % BLOCK_SIZE);
-    if(padding == BLOCK_SIZE) padding = 0;
-    
-    for(int i = 0; i < padding; i++){
-        padded.push_back((unsigned char)padding);
+    bool contains(sf::Vector2f point) const {
+        return sf::FloatRect(origin.x, origin.y, size.x, size.y).contains(point);
     }
-    return padded;
-}
 
-// Quitar el relleno del bloque
-vector<unsigned char> unpadBlock(const vector<unsigned char>& data){
-    if(data.empty()) return data;
-    
-    unsigned char padding = data[data.size() - 1];
-    if(padding > 0 && padding <= BLOCK_SIZE){
-        vector<unsigned char> unpadded = data;
-        unpadded.resize(data.size() - padding);
-        return unpadded;
-    }
-    return data;
-}
-
-// Dividir el texto en bloques
-vector<vector<unsigned char>> splitIntoBlocks(const vector<unsigned char>& data){
-    vector<vector<unsigned char>> blocks;
-    
-    for(int i = 0; i < data.size(); i += BLOCK_SIZE){
-        vector<unsigned char> block;
-        for(int j = 0; j < BLOCK_SIZE && i + j < data.size(); j++){
-            block.push_back(data[i + j]);
+    void draw(sf::RenderWindow& window) const {
+        for (const sf::Text& row : rows) window.draw(row);
+        if (rowCount() > rows.size()) {
+            window.draw(track);
+            window.draw(thumb);
         }
-        blocks.push_back(block);
     }
-    
-    return blocks;
-}
 
-// Cifrar texto completo
-vector<unsigned char> encryptText(const string& text, const string& key){
-    vector<unsigned char> data(text.begin(), text.end());
-    vector<unsigned char> padded = padBlock(data);
-    vector<vector<unsigned char>> blocks = splitIntoBlocks(padded);
-    
-    vector<unsigned char> encrypted;
-    for(auto& block : blocks){
-        vector<unsigned char> encryptedBlock = encryptBlock(block, key);
-        encrypted.insert(encrypted.end(), encryptedBlock.begin(), encryptedBlock.end());
+private:
+    void layout() {
+        const uint64_t total = rowCount();
+        for (size_t r = 0; r < rows.size(); r++) {
+            uint64_t row = firstRow + r;
+            if (row >= total) { rows[r].setString(""); continue; }
+            uint64_t offset = row * HEX_ROW_BYTES;
+            size_t length = (size_t)min<uint64_t>(HEX_ROW_BYTES, data->size() - offset);
+            char line[32 + 3 * HEX_ROW_BYTES];
+            int prefix = snprintf(line, 32, "%08llx  ", (unsigned long long)offset);
+            hexEncodeSeparated(data->data() + offset, length, line + prefix, ' ');
+            rows[r].setString(string(line, prefix + 3 * length));
+        }
+        if (total > rows.size()) {
+            float height = max(10.f, size.y * rows.size() / total);
+            float position = (size.y - height) * firstRow / (total - rows.size());
+            thumb.setSize({HEX_SCROLLBAR_WIDTH, height});
+            thumb.setPosition(origin.x + size.x - HEX_SCROLLBAR_WIDTH, origin.y + position);
+        }
     }
-    
-    return encrypted;
-}
 
-// Descifrar texto completo
-string decryptText(const vector<unsigned char>& encrypted, const string& key){
-    vector<vector<unsigned char>> blocks = splitIntoBlocks(encrypted);
-    
-    vector<unsigned char> decrypted;
-    for(auto& block : blocks){
-        vector<unsigned char> decryptedBlock = decryptBlock(block, key);
-        decrypted.insert(decrypted.end(), decryptedBlock.begin(), decryptedBlock.end());
-    }
-    
-    vector<unsigned char> unpadded = unpadBlock(decrypted);
-    return string(unpadded.begin(), unpadded.end());
-}
+    const vector<unsigned char>* data = nullptr;
+    uint64_t firstRow = 0;
+    sf::Vector2f origin, size;
+    vector<sf::Text> rows;
+    sf::RectangleShape track, thumb;
+};
 
 // =======================================================
 // ===================== INTERFAZ CON SFML =======================
+// La ventana solo se redibuja cuando algo cambió (una entrada, el parpadeo del cursor o el
+// avance de un trabajo); sin cambios el bucle duerme IDLE_SLEEP_MS entre revisiones.
+
+constexpr int IDLE_SLEEP_MS = 10;
+constexpr int PROGRESS_REFRESH_MS = 100;
 class CryptoGUI {
 private:
     sf::RenderWindow window;
@@ -169,16 +187,32 @@ private:
     sf::Text titleText;
     
     sf::RectangleShape inputBox, keyBox, cipherBox, decryptedBox;
-    sf::Text inputDisplay, keyDisplay, cipherDisplay, decryptedDisplay;
+    sf::Text inputDisplay, keyDisplay, decryptedDisplay;
+    HexView cipherView;
+
+    sf::RectangleShape encryptButton, decryptButton, saveButton, loadButton, exportButton, clearButton;
+    sf::Text encryptButtonText, decryptButtonText, saveText, loadText, exportText, clearText;
 
-    sf::RectangleShape encryptButton, decryptButton, saveButton, loadButton, clearButton;
-    sf::Text encryptButtonText, decryptButtonText, saveText, loadText, clearText;
+    // ==== TRABAJO EN CURSO ====
+    unique_ptr<CryptoJob> job;
+    sf::RectangleShape progressBack, progressFill, cancelButton;
+    sf::Text progressText, cancelText;
+    sf::Clock progressClock;
+
+    // ==== ESTADÍSTICAS (F3) ====
+    bool showStats = false;
+    sf::RectangleShape statsBack;
+    sf::Text statsText;
 
     sf::Text statusText;
 
     string inputText, keyText, encryptedHex, decryptedText;
-    string ciphertextFilename = "ciphertext.txt";
-    bool inputActive = false, keyActive = false;
+    vector<unsigned char> encryptedBytes;
+    ContainerHeader cipherHeader;
+    bool hasCipherHeader = false;
+    string ciphertextFilename = "ciphertext.bcas";
+    string hexExportFilename = "ciphertext.txt";
+    bool inputActive = false, keyActive = false, cipherActive = false;
 
     // ==== CURSOR ====
     bool showCursor = true;
@@ -187,49 +221,96 @@ private:
 
     // ==== FUNCIONES DE AYUDA PARA HEX ====
     static bool parseHexString(const string &hexStr, vector<unsigned char> &out, string &errMsg) {
-        out.clear();
-        string s;
-        for (char c : hexStr) {
-            if (isxdigit((unsigned char)c)) s.push_back(c);
-            else if (isspace((unsigned char)c)) continue;
-            else { errMsg = "Hex invalido: '" + string(1, c) + "'"; return false; }
+        out.resize((hexStr.size() + 1) / 2);
+        size_t written = 0;
+        uint64_t errorOffset = 0;
+        HexStatus status = hexDecode(hexStr.data(), hexStr.size(), out.data(), written, errorOffset);
+        out.resize(written);
+        if (status == HEX_INVALID_CHARACTER) {
+            errMsg = "Hex invalido: '" + string(1, hexStr[errorOffset]) + "' en la posicion " + to_string(errorOffset);
+            return false;
         }
-        if (s.size() % 2 != 0) { errMsg = "Hex invalido: longitud impar."; return false; }
-        try {
-            for (size_t i = 0; i < s.size(); i += 2) {
-                string byteStr = s.substr(i, 2);
-                unsigned int val = stoi(byteStr, nullptr, 16);
-                out.push_back((unsigned char)val);
-            }
-        } catch (...) { errMsg = "Error al convertir hex."; return false; }
+        if (status == HEX_ODD_LENGTH) { errMsg = "Hex invalido: longitud impar."; return false; }
         return true;
     }
 
-    bool saveCipherToFile(const string &hexText) {
+    // Contenedor binario (cabecera + bloques cifrados)
+    bool saveCipherToFile() {
+        if (encryptedBytes.empty() || !hasCipherHeader) return false;
+        ofstream ofs(ciphertextFilename, ios::out | ios::binary | ios::trunc);
+        if (!ofs.is_open()) return false;
+        unsigned char header[CONTAINER_MAX_HEADER_SIZE];
+        ofs.write((const char*)header, encodeContainerHeader(cipherHeader, header));
+        ofs.write((const char*)encryptedBytes.data(), encryptedBytes.size());
+        return (bool)ofs;
+    }
+
+    // Exportación opcional en hexadecimal
+    bool exportHexToFile(const string &hexText) {
         if (hexText.empty()) return false;
-        ofstream ofs(ciphertextFilename, ios::out | ios::trunc);
+        ofstream ofs(hexExportFilename, ios::out | ios::trunc);
         if (!ofs.is_open()) return false;
         ofs << hexText;
         ofs.close();
         return true;
     }
 
-    bool loadCipherFromFile(string &hexText) {
-        ifstream ifs(ciphertextFilename, ios::in);
-        if (!ifs.is_open()) return false;
+    // Carga el contenedor binario; si no existe, el archivo hexadecimal
+    bool loadCipherFromFile(string &loadedFrom, string &errMsg) {
+        ifstream bin(ciphertextFilename, ios::in | ios::binary);
+        if (bin.is_open()) {
+            stringstream ss; ss << bin.rdbuf();
+            string content = ss.str();
+            ContainerHeader header;
+            bool hasHeader = false;
+            vector<unsigned char> bytes;
+            if (!hasContainerMagic((const unsigned char*)content.data(), content.size())) { errMsg = "not a BitCascade container"; return false; }
+            // El parser de la biblioteca valida la cabecera y la longitud; la GUI solo descifra ECB
+            if (!parseCiphertext(content, bytes, header, hasHeader) || !hasHeader || header.mode != MODE_ECB) {
+                errMsg = "unsupported or corrupted container";
+                return false;
+            }
+            encryptedBytes.swap(bytes);
+            cipherHeader = header;
+            hasCipherHeader = true;
+            loadedFrom = ciphertextFilename;
+            return true;
+        }
+
+        ifstream ifs(hexExportFilename, ios::in);
+        if (!ifs.is_open()) { errMsg = "no " + ciphertextFilename + " or " + hexExportFilename; return false; }
         stringstream ss; ss << ifs.rdbuf();
-        hexText = ss.str();
-        while (!hexText.empty() && isspace((unsigned char)hexText.back())) hexText.pop_back();
-        ifs.close();
+        string hexText = ss.str();
+        vector<unsigned char> bytes;
+        if (!parseHexString(hexText, bytes, errMsg)) return false;
+        encryptedBytes = bytes;
+        hasCipherHeader = false;
+        loadedFrom = hexExportFilename;
         return true;
     }
 
+    static string toHexDisplay(const vector<unsigned char> &bytes) {
+        string hexText(bytes.size() * 3, ' ');
+        hexEncodeSeparated(bytes.data(), bytes.size(), &hexText[0], ' ');
+        return hexText;
+    }
+
+    // Las cajas solo muestran un fragmento: dibujar megabytes de texto congelaría la ventana
+    static string previewHead(const string &text, size_t limit) {
+        return text.size() <= limit ? text : text.substr(0, limit) + "...";
+    }
+
+    static string previewTail(const string &text, size_t limit) {
+        return text.size() <= limit ? text : "..." + text.substr(text.size() - limit);
+    }
+
 public:
     CryptoGUI() : window(sf::VideoMode(900, 700), "BitCascade - SFML") {
         if (!font.loadFromFile("arial.ttf")) {
             // Intentar cargar desde ruta común de Windows
             font.loadFromFile("C:/Windows/Fonts/arial.ttf");
         }
+        window.setFramerateLimit(60);
         setupUI();
 
         inputActive = true;
@@ -237,6 +318,13 @@ public:
         updateDisplay();
     }
 
+    ~CryptoGUI() {
+        if (job) {
+            job->cancelRequested = true;
+            job->worker.join();
+        }
+    }
+
     void setupUI() {
         titleText.setFont(font);
         titleText.setString("BitCascade Algorithm");
@@ -280,10 +368,7 @@ public:
         keyDisplay.setFillColor(sf::Color::Yellow);
         keyDisplay.setPosition(60, 220);
 
-        cipherDisplay.setFont(font);
-        cipherDisplay.setCharacterSize(14);
-        cipherDisplay.setFillColor(sf::Color::Green);
-        cipherDisplay.setPosition(60, 290);
+        cipherView.setup(font, cipherBox, 14);
 
         decryptedDisplay.setFont(font);
         decryptedDisplay.setCharacterSize(16);
@@ -292,7 +377,7 @@ public:
 
         // Etiquetas
         inputLabel.setFont(font);
-        inputLabel.setString("Plaintext (max 100 chars):");
+        inputLabel.setString("Plaintext (Ctrl+V to paste):");
         inputLabel.setCharacterSize(16);
         inputLabel.setFillColor(sf::Color::White);
         inputLabel.setPosition(inputBox.getPosition().x, inputBox.getPosition().y - 25);
@@ -304,7 +389,7 @@ public:
         keyLabel.setPosition(keyBox.getPosition().x, keyBox.getPosition().y - 25);
 
         cipherLabel.setFont(font);
-        cipherLabel.setString("Ciphertext (Hex):");
+        cipherLabel.setString("Ciphertext (Hex, wheel/arrows to scroll):");
         cipherLabel.setCharacterSize(16);
         cipherLabel.setFillColor(sf::Color::White);
         cipherLabel.setPosition(cipherBox.getPosition().x, cipherBox.getPosition().y - 25);
@@ -320,13 +405,44 @@ public:
         setupButton(decryptButton, decryptButtonText, "DECRYPT", 500, 170, sf::Color(0, 100, 200));
         setupButton(saveButton, saveText, "SAVE CIPHER", 500, 240, sf::Color(120, 120, 120));
         setupButton(loadButton, loadText, "LOAD CIPHER", 500, 310, sf::Color(120, 120, 120));
-        setupButton(clearButton, clearText, "CLEAN ALL", 500, 380, sf::Color(200, 50, 50));
+        setupButton(exportButton, exportText, "EXPORT HEX", 500, 380, sf::Color(120, 120, 120));
+        setupButton(clearButton, clearText, "CLEAN ALL", 500, 450, sf::Color(200, 50, 50));
 
         statusText.setFont(font);
         statusText.setCharacterSize(16);
         statusText.setFillColor(sf::Color::White);
-        statusText.setPosition(50, 500);
+        statusText.setPosition(50, 520);
         statusText.setString("Ready. Enter text and key, then click ENCRYPT.");
+
+        // Barra de progreso y botón de cancelar, visibles solo con un trabajo en curso
+        progressBack.setSize({400, 20});
+        progressBack.setPosition(50, 560);
+        progressBack.setFillColor(sf::Color(50, 50, 80));
+        progressBack.setOutlineColor(sf::Color::White);
+        progressBack.setOutlineThickness(2);
+
+        progressFill.setSize({0, 20});
+        progressFill.setPosition(50, 560);
+        progressFill.setFillColor(sf::Color(0, 200, 0));
+
+        progressText.setFont(font);
+        progressText.setCharacterSize(14);
+        progressText.setFillColor(sf::Color::White);
+        progressText.setPosition(50, 590);
+
+        setupButton(cancelButton, cancelText, "CANCEL", 500, 545, sf::Color(200, 50, 50));
+
+        // Panel de estadísticas por fase, encima de todo lo demás
+        statsBack.setSize({820, 220});
+        statsBack.setPosition(40, 60);
+        statsBack.setFillColor(sf::Color(0, 0, 0, 220));
+        statsBack.setOutlineColor(sf::Color::Cyan);
+        statsBack.setOutlineThickness(2);
+
+        statsText.setFont(font);
+        statsText.setCharacterSize(14);
+        statsText.setFillColor(sf::Color::White);
+        statsText.setPosition(55, 70);
     }
 
     void setupButton(sf::RectangleShape &button, sf::Text &label, const string &text,
@@ -347,50 +463,78 @@ public:
     }
 
     void run() {
+        bool dirty = true;
         while (window.isOpen()) {
-            handleEvents();
-            handleCursor();
-            render();
+            if (handleEvents()) dirty = true;
+            if (pollJob()) dirty = true;
+            if (handleCursor()) dirty = true;
+            if (dirty && window.isOpen()) {
+                render();
+                dirty = false;
+            } else {
+                sf::sleep(sf::milliseconds(IDLE_SLEEP_MS));
+            }
         }
     }
 
-    void handleEvents() {
+    // Devuelve true si llegó algún evento (cualquiera puede cambiar lo que se ve)
+    bool handleEvents() {
+        bool handled = false;
         sf::Event event;
         while (window.pollEvent(event)) {
+            handled = true;
             if (event.type == sf::Event::Closed) window.close();
 
             if (event.type == sf::Event::MouseButtonPressed) {
                 auto mp = window.mapPixelToCoords({event.mouseButton.x, event.mouseButton.y});
                 inputActive = inputBox.getGlobalBounds().contains(mp);
                 keyActive = keyBox.getGlobalBounds().contains(mp);
-
-                if (encryptButton.getGlobalBounds().contains(mp)) encryptData();
+                cipherActive = cipherView.contains(mp);
+
+                // Mientras el hilo trabaja con los datos solo se puede cancelar
+                if (job) {
+                    if (cancelButton.getGlobalBounds().contains(mp)) {
+                        job->cancelRequested = true;
+                        statusText.setString("Cancelling...");
+                        statusText.setFillColor(sf::Color::Yellow);
+                    }
+                } else if (encryptButton.getGlobalBounds().contains(mp)) encryptData();
                 else if (decryptButton.getGlobalBounds().contains(mp)) decryptData();
                 else if (saveButton.getGlobalBounds().contains(mp)) {
-                    if (saveCipherToFile(encryptedHex)) {
+                    if (saveCipherToFile()) {
                         statusText.setString("Cipher saved to " + ciphertextFilename);
                         statusText.setFillColor(sf::Color::Green);
                     } else {
                         statusText.setString("Error saving file");
                         statusText.setFillColor(sf::Color::Red);
                     }
+                } else if (exportButton.getGlobalBounds().contains(mp)) {
+                    if (exportHexToFile(encryptedHex)) {
+                        statusText.setString("Hex exported to " + hexExportFilename);
+                        statusText.setFillColor(sf::Color::Green);
+                    } else {
+                        statusText.setString("Error exporting hex");
+                        statusText.setFillColor(sf::Color::Red);
+                    }
                 } else if (loadButton.getGlobalBounds().contains(mp)) {
-                    string loaded;
-                    if (loadCipherFromFile(loaded)) {
-                        encryptedHex = loaded;
-                        cipherDisplay.setString(encryptedHex);
-                        statusText.setString("Cipher loaded from " + ciphertextFilename);
+                    string loadedFrom, loadErr;
+                    if (loadCipherFromFile(loadedFrom, loadErr)) {
+                        encryptedHex = toHexDisplay(encryptedBytes);
+                        cipherView.setData(&encryptedBytes);
+                        statusText.setString("Cipher loaded from " + loadedFrom);
                         statusText.setFillColor(sf::Color::Green);
                     } else {
-                        statusText.setString("Error loading file");
+                        statusText.setString("Error loading file: " + loadErr);
                         statusText.setFillColor(sf::Color::Red);
                     }
                 } else if (clearButton.getGlobalBounds().contains(mp)) {
                     inputText.clear();
                     keyText.clear();
                     encryptedHex.clear();
+                    encryptedBytes.clear();
+                    hasCipherHeader = false;
                     decryptedText.clear();
-                    cipherDisplay.setString("");
+                    cipherView.setData(&encryptedBytes);
                     decryptedDisplay.setString("");
                     updateDisplay();
                     statusText.setString("All fields cleaned");
@@ -405,31 +549,62 @@ public:
                         if (inputActive && !inputText.empty()) inputText.pop_back();
                         else if (keyActive && !keyText.empty()) keyText.pop_back();
                     } else if (c >= 32) {
-                        if (inputActive && inputText.length() < 100) inputText.push_back(c);
+                        if (inputActive) inputText.push_back(c);
                         else if (keyActive && keyText.length() < 16) keyText.push_back(c);
                     }
                     updateDisplay();
                 }
             }
+
+            // Ctrl+V pega el portapapeles en el texto plano, sin límite de tamaño
+            if (event.type == sf::Event::KeyPressed && event.key.control && event.key.code == sf::Keyboard::V && inputActive) {
+                inputText += sf::Clipboard::getString().toAnsiString();
+                updateDisplay();
+            }
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3) {
+                showStats = !showStats;
+                refreshStats();
+            }
+
+            // Desplazamiento del visor hexadecimal: rueda sobre la caja o teclas con la caja activa
+            if (event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel &&
+                cipherView.contains(window.mapPixelToCoords({event.mouseWheelScroll.x, event.mouseWheelScroll.y}))) {
+                cipherView.scrollBy(event.mouseWheelScroll.delta > 0 ? -HEX_WHEEL_ROWS : HEX_WHEEL_ROWS);
+            }
+            if (event.type == sf::Event::KeyPressed && cipherActive) {
+                const int64_t page = (int64_t)cipherView.visibleRows();
+                switch (event.key.code) {
+                    case sf::Keyboard::Up: cipherView.scrollBy(-1); break;
+                    case sf::Keyboard::Down: cipherView.scrollBy(1); break;
+                    case sf::Keyboard::PageUp: cipherView.scrollBy(-page); break;
+                    case sf::Keyboard::PageDown: cipherView.scrollBy(page); break;
+                    case sf::Keyboard::Home: cipherView.scrollBy(-INT64_MAX); break;
+                    case sf::Keyboard::End: cipherView.scrollBy(INT64_MAX); break;
+                    default: break;
+                }
+            }
         }
+        return handled;
     }
 
-    void handleCursor() {
-        if (cursorClock.getElapsedTime().asSeconds() >= cursorInterval) {
-            showCursor = !showCursor;
-            cursorClock.restart();
-            updateDisplay();
-        }
+    // Devuelve true si el cursor parpadeó en una caja activa
+    bool handleCursor() {
+        if (cursorClock.getElapsedTime().asSeconds() < cursorInterval) return false;
+        showCursor = !showCursor;
+        cursorClock.restart();
+        updateDisplay();
+        return inputActive || keyActive;
     }
 
     void updateDisplay() {
         string cursorChar = (showCursor && inputActive) ? "|" : "";
-        inputDisplay.setString(inputText + cursorChar);
+        inputDisplay.setString(previewTail(inputText, TEXT_PREVIEW_CHARS) + cursorChar);
         
         cursorChar = (showCursor && keyActive) ? "|" : "";
         keyDisplay.setString(keyText + cursorChar);
         
-        decryptedDisplay.setString(decryptedText);
+        decryptedDisplay.setString(previewHead(decryptedText, TEXT_PREVIEW_CHARS));
     }
 
     void encryptData() {
@@ -439,99 +614,122 @@ public:
             return;
         }
         
-        // Limitar a 100 caracteres si es necesario
-        string textToEncrypt = inputText;
-        if (textToEncrypt.length() > 100) {
-            textToEncrypt = textToEncrypt.substr(0, 100);
-            statusText.setString("Text truncated to 100 characters. Encrypting...");
-        } else {
-            statusText.setString("Encrypting...");
-        }
-        
         // Limitar clave a 16 caracteres
         string keyToUse = keyText;
+        string note;
         if (keyToUse.length() > 16) {
             keyToUse = keyToUse.substr(0, 16);
-            statusText.setString(statusText.getString() + " Key truncated to 16 chars.");
+            note = " Key truncated to 16 chars.";
         }
         
-        statusText.setFillColor(sf::Color::Yellow);
-        window.draw(statusText);
-        window.display();
-        
-        try {
-            vector<unsigned char> encrypted = encryptText(textToEncrypt, keyToUse);
-            
-            stringstream ss;
-            ss << hex << setfill('0');
-            for (auto c : encrypted) ss << setw(2) << (int)c << " ";
-            encryptedHex = ss.str();
-            
-            cipherDisplay.setString(encryptedHex);
-            statusText.setString("Encryption successful! Text length: " + to_string(textToEncrypt.length()) + " chars");
-            statusText.setFillColor(sf::Color::Green);
-        } catch (const exception& e) {
-            statusText.setString("Encryption error: " + string(e.what()));
-            statusText.setFillColor(sf::Color::Red);
-        }
+        KeySchedule schedule = *sharedKeyCache().get(keyToUse);
+        ContainerHeader header = makeContainerHeader(inputText.length(), schedule);
+        startJob(true, inputText.size(), "Encrypting..." + note, [text = inputText, schedule, header](CryptoJob& job) {
+            job.header = header;
+            runEncryptJob(job, text, schedule);
+        });
     }
 
     void decryptData() {
-    if (encryptedHex.empty() || keyText.empty()) {
-        statusText.setString("Error: no ciphertext or key");
-        statusText.setFillColor(sf::Color::Red);
-        return;
-    }
-    
-    statusText.setString("Decrypting...");
-    statusText.setFillColor(sf::Color::Yellow);
-    window.draw(statusText);
-    window.display();
-    
-    try {
-        vector<unsigned char> encryptedBytes;
-        string parseErr;
-        if (!parseHexString(encryptedHex, encryptedBytes, parseErr)) {
-            statusText.setString("Invalid hex: " + parseErr);
+        if (encryptedBytes.empty() || keyText.empty()) {
+            statusText.setString("Error: no ciphertext or key");
             statusText.setFillColor(sf::Color::Red);
             return;
         }
         
-        string decryptedResult = decryptText(encryptedBytes, keyText);
+        // Con contenedor, el valor de verificación rechaza una llave incorrecta sin descifrar nada;
+        // después se descifra solo el último bloque y se revisa su relleno antes de lanzar el hilo
+        KeySchedule schedule = *sharedKeyCache().get(keyText, hasCipherHeader ? cipherHeader.blockSize : BLOCK_SIZE);
+        bool validKey = !hasCipherHeader || cipherHeader.keyCheck == keyCheckValue(schedule);
+        if (validKey) checkTailBlock(encryptedBytes, schedule, validKey);
+        if (!validKey) {
+            showWrongKey();
+            return;
+        }
+        // Los botones que cambian encryptedBytes están bloqueados mientras el hilo lo lee
+        const vector<unsigned char>& encrypted = encryptedBytes;
+        startJob(false, encryptedBytes.size(), "Decrypting...",
+                 [&encrypted, schedule](CryptoJob& job) { runDecryptJob(job, encrypted, schedule); });
+    }
+
+    void startJob(bool encrypting, uint64_t bytesTotal, const string& status, function<void(CryptoJob&)> work) {
+        job.reset(new CryptoJob());
+        job->encrypting = encrypting;
+        job->bytesTotal = bytesTotal;
+        CryptoJob* running = job.get();
+        running->worker = thread([running, work] {
+            try {
+                work(*running);
+            } catch (const exception& e) {
+                running->error = e.what();
+            }
+            running->finished = true;
+        });
+        statusText.setString(status);
+        statusText.setFillColor(sf::Color::Yellow);
+        progressFill.setSize({0, 20});
+        progressText.setString("");
+        progressClock.restart();
+    }
+
+    // Recoge el resultado cuando el hilo termina; mientras tanto actualiza la barra de progreso
+    // cada PROGRESS_REFRESH_MS. Devuelve true si hay algo nuevo que dibujar.
+    bool pollJob() {
+        if (!job) return false;
+        if (!job->finished) {
+            if (progressClock.getElapsedTime().asMilliseconds() < PROGRESS_REFRESH_MS) return false;
+            progressClock.restart();
+            uint64_t done = job->bytesDone;
+            float fraction = job->bytesTotal ? (float)done / job->bytesTotal : 0.f;
+            float seconds = job->clock.getElapsedTime().asSeconds();
+            progressFill.setSize({400 * fraction, 20});
+            ostringstream text;
+            text << fixed << setprecision(0) << fraction * 100 << "%  " << setprecision(1)
+                 << (seconds > 0 ? done / seconds / (1024 * 1024) : 0.0) << " MB/s";
+            progressText.setString(text.str());
+            refreshStats();
+            return true;
+        }
+        job->worker.join();
+        unique_ptr<CryptoJob> done = move(job);
+        refreshStats();
         
-        // Validación de la llave para desencriptar
-        if (containsMostlyPrintableChars(decryptedResult)) {
-            decryptedText = decryptedResult;
-            decryptedDisplay.setString(decryptedText);
+        if (!done->error.empty()) {
+            statusText.setString((done->encrypting ? "Encryption error: " : "Decryption error: ") + done->error);
+            statusText.setFillColor(sf::Color::Red);
+        } else if (done->cancelled) {
+            statusText.setString(done->encrypting ? "Encryption cancelled" : "Decryption cancelled");
+            statusText.setFillColor(sf::Color::Yellow);
+        } else if (done->encrypting) {
+            encryptedBytes = move(done->encrypted);
+            encryptedHex = move(done->hex);
+            cipherHeader = done->header;
+            hasCipherHeader = true;
+            cipherView.setData(&encryptedBytes);
+            statusText.setString("Encryption successful! Text length: " + to_string(cipherHeader.originalLength) + " chars");
+            statusText.setFillColor(sf::Color::Green);
+        } else if (done->validKey) {
+            decryptedText = move(done->decrypted);
+            decryptedDisplay.setString(previewHead(decryptedText, TEXT_PREVIEW_CHARS));
             statusText.setString("Decryption successful!");
             statusText.setFillColor(sf::Color::Green);
         } else {
-            decryptedText = "[INVALID DATA - WRONG KEY]";
-            decryptedDisplay.setString(decryptedText);
-            statusText.setString("ERROR: Wrong key or corrupted data!");
-            statusText.setFillColor(sf::Color::Red);
+            showWrongKey();
         }
-        
-    } catch (const exception& e) {
-        statusText.setString("Decryption error: " + string(e.what()));
-        statusText.setFillColor(sf::Color::Red);
+        return true;
     }
-}
 
-bool containsMostlyPrintableChars(const string& text) {
-    if (text.empty()) return false;
-    
-    int printableCount = 0;
-    for (char c : text) {
-        // Caracteres imprimibles ASCII (32-126) + espacios + saltos de línea comunes
-        if ((c >= 32 && c <= 126) || c == ' ' || c == '\n' || c == '\t' || c == '\r') {
-            printableCount++;
-        }
+    // Los contadores solo se leen mientras el panel está visible
+    void refreshStats() {
+        if (showStats) statsText.setString("Statistics (F3 to hide)\n" + formatStats(collectStats(), false));
+    }
+
+    void showWrongKey() {
+        decryptedText = "[INVALID DATA - WRONG KEY]";
+        decryptedDisplay.setString(decryptedText);
+        statusText.setString("ERROR: Wrong key or corrupted data!");
+        statusText.setFillColor(sf::Color::Red);
     }
-    
-    // Considerar válido si al menos el 80% son caracteres imprimibles
-    return (float)printableCount / text.length() >= 0.8f;
-}
 
     void render() {
         window.clear(sf::Color(30, 30, 60));
@@ -541,17 +739,27 @@ bool containsMostlyPrintableChars(const string& text) {
         
         window.draw(inputLabel); window.draw(inputBox); window.draw(inputDisplay);
         window.draw(keyLabel); window.draw(keyBox); window.draw(keyDisplay);
-        window.draw(cipherLabel); window.draw(cipherBox); window.draw(cipherDisplay);
+        window.draw(cipherLabel); window.draw(cipherBox); cipherView.draw(window);
         window.draw(decryptedLabel); window.draw(decryptedBox); window.draw(decryptedDisplay);
         
         window.draw(encryptButton); window.draw(encryptButtonText);
         window.draw(decryptButton); window.draw(decryptButtonText);
         window.draw(saveButton); window.draw(saveText);
         window.draw(loadButton); window.draw(loadText);
+        window.draw(exportButton); window.draw(exportText);
         window.draw(clearButton); window.draw(clearText);
         
         window.draw(statusText);
         
+        if (job) {
+            window.draw(progressBack); window.draw(progressFill); window.draw(progressText);
+            window.draw(cancelButton); window.draw(cancelText);
+        }
+
+        if (showStats) {
+            window.draw(statsBack); window.draw(statsText);
+        }
+        
         window.display();
     }
 };
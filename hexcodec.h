@@ -0,0 +1,160 @@
+#pragma once
+// Single-pass hex encoder/decoder shared by the CLI and the GUI.
+// Both directions write into a caller-provided buffer: lookup tables on the scalar
+// path, and SSE2 for 16 bytes / 32 digits at a time on x86-64.
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HEXCODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+enum HexStatus {
+    HEX_OK = 0,
+    HEX_INVALID_CHARACTER, // errorOffset is the offset of the character
+    HEX_ODD_LENGTH,        // errorOffset is the end of the input
+};
+
+constexpr signed char HEX_SKIP = -2;    // whitespace between digits
+constexpr signed char HEX_INVALID = -1;
+
+struct HexTables {
+    char pairs[512];        // two lowercase digits for every byte value
+    signed char values[256]; // digit value, HEX_SKIP or HEX_INVALID for every character
+};
+
+constexpr HexTables makeHexTables(){
+    HexTables tables = {};
+    const char digits[] = "0123456789abcdef";
+    for(int i = 0; i < 256; i++){
+        tables.pairs[2 * i] = digits[i >> 4];
+        tables.pairs[2 * i + 1] = digits[i & 0x0F];
+        tables.values[i] = HEX_INVALID;
+    }
+    for(int i = 0; i < 10; i++) tables.values['0' + i] = (signed char)i;
+    for(int i = 0; i < 6; i++){
+        tables.values['a' + i] = (signed char)(10 + i);
+        tables.values['A' + i] = (signed char)(10 + i);
+    }
+    const char whitespace[] = {' ', '\t', '\n', '\r', '\v', '\f'};
+    for(char c : whitespace) tables.values[(unsigned char)c] = HEX_SKIP;
+    return tables;
+}
+
+constexpr HexTables HEX_TABLES = makeHexTables();
+
+#ifdef HEXCODEC_SSE2
+// Lowercase ASCII digit for every nibble (0..15) in x
+inline __m128i hexDigitsSSE2(__m128i nibbles){
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+// Decodes 32 digits into 16 bytes; returns false (writing nothing) if any character is not a digit
+inline bool decodeHex32SSE2(const char* in, unsigned char* out){
+    __m128i values[2];
+    for(int half = 0; half < 2; half++){
+        __m128i c = _mm_loadu_si128((const __m128i*)(in + 16 * half));
+        __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)), _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(letter, _mm_set1_epi8(-1)), _mm_cmplt_epi8(letter, _mm_set1_epi8(6)));
+        if(_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF) return false;
+        __m128i letterValue = _mm_add_epi8(letter, _mm_set1_epi8(10));
+        values[half] = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, letterValue));
+    }
+    // Each 16-bit lane holds (high digit, low digit); combine them into the low byte and pack
+    for(int half = 0; half < 2; half++){
+        __m128i high = _mm_and_si128(values[half], _mm_set1_epi16(0x00FF));
+        __m128i low = _mm_srli_epi16(values[half], 8);
+        values[half] = _mm_or_si128(_mm_slli_epi16(high, 4), low);
+    }
+    _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(values[0], values[1]));
+    return true;
+}
+#endif
+
+// Writes 2 * length lowercase digits to out
+inline void hexEncode(const unsigned char* in, size_t length, char* out){
+    size_t i = 0;
+#ifdef HEXCODEC_SSE2
+    for(; i + 16 <= length; i += 16){
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i high = hexDigitsSSE2(_mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0F)));
+        __m128i low = hexDigitsSSE2(_mm_and_si128(bytes, _mm_set1_epi8(0x0F)));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+#endif
+    for(; i < length; i++){
+        out[2 * i] = HEX_TABLES.pairs[2 * in[i]];
+        out[2 * i + 1] = HEX_TABLES.pairs[2 * in[i] + 1];
+    }
+}
+
+// Writes 3 * length characters to out: two digits and the separator after every byte
+inline void hexEncodeSeparated(const unsigned char* in, size_t length, char* out, char separator){
+    for(size_t i = 0; i < length; i++){
+        out[3 * i] = HEX_TABLES.pairs[2 * in[i]];
+        out[3 * i + 1] = HEX_TABLES.pairs[2 * in[i] + 1];
+        out[3 * i + 2] = separator;
+    }
+}
+
+// Decoding state carried between chunks of one hex stream
+struct HexDecodeState {
+    int highNibble = -1; // first digit of a byte split across chunks
+    uint64_t offset = 0; // characters consumed so far
+};
+
+// Decodes one chunk of hex text, skipping whitespace. out needs room for
+// (length + 1) / 2 bytes; written receives the number of bytes produced.
+// On HEX_INVALID_CHARACTER, errorOffset is the offset from the start of the stream.
+inline HexStatus hexDecodeChunk(const char* in, size_t length, unsigned char* out, size_t& written,
+                                HexDecodeState& state, uint64_t& errorOffset){
+    written = 0;
+    size_t i = 0;
+    while(i < length){
+#ifdef HEXCODEC_SSE2
+        if(state.highNibble < 0 && i + 32 <= length){
+            if(decodeHex32SSE2(in + i, out + written)){
+                written += 16;
+                i += 32;
+                continue;
+            }
+        }
+        // Whitespace or a bad digit somewhere in the next 32 characters: go scalar for them
+        size_t end = (i + 32 < length) ? i + 32 : length;
+#else
+        size_t end = length;
+#endif
+        for(; i < end; i++){
+            signed char value = HEX_TABLES.values[(unsigned char)in[i]];
+            if(value < 0){
+                if(value == HEX_SKIP) continue;
+                errorOffset = state.offset + i;
+                return HEX_INVALID_CHARACTER;
+            }
+            if(state.highNibble < 0){
+                state.highNibble = value;
+            } else {
+                out[written++] = (unsigned char)(state.highNibble << 4 | value);
+                state.highNibble = -1;
+            }
+        }
+    }
+    state.offset += length;
+    return HEX_OK;
+}
+
+// Decodes a complete hex string; out needs room for (length + 1) / 2 bytes
+inline HexStatus hexDecode(const char* in, size_t length, unsigned char* out, size_t& written, uint64_t& errorOffset){
+    HexDecodeState state;
+    HexStatus status = hexDecodeChunk(in, length, out, written, state, errorOffset);
+    if(status == HEX_OK && state.highNibble >= 0){
+        errorOffset = length;
+        return HEX_ODD_LENGTH;
+    }
+    return status;
+}
@@ -0,0 +1,470 @@
+// Known-plaintext key search, for auditing how much of the key space the cipher really uses.
+//
+//   keysearch.exe (--pair PLAIN CIPHER [--pair PLAIN CIPHER ...] | --target KEY)
+//                 [--alphabet CHARS] [--min-length N] [--max-length N] [--distinct]
+//                 [--threads N] [--seconds S] [--backend NAME] [--max-matches N]
+//
+// PLAIN and CIPHER are one 8-byte block each, as 16 hex digits; --target KEY makes two
+// pairs from a key instead. Every candidate of the alphabet/length spec is tried on the
+// first pair, and the few that survive are checked against the remaining pairs.
+// Candidates are enumerated in chunks on the shared work-stealing pool, and the first
+// block is encrypted under many candidates at once by the multi-key kernels (one key per
+// SIMD lane), with subkeys taken straight from the key word instead of a KeySchedule.
+//
+// 8-byte blocks only see a key through its key word (see keyWord()), so the search also
+// counts the candidates whose word a shorter candidate already produced: periodic keys
+// ("abab" is "ab") and keys longer than 8 characters (only the first 8 count).
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "bitcascade.h"
+using namespace std;
+
+constexpr size_t CHUNK_CANDIDATES = 64 * 1024; // candidates per pool task
+constexpr size_t CHUNKS_PER_THREAD = 16;       // tasks per wave; the time limit is checked between waves
+constexpr size_t LANE_BATCH = 64;              // candidates per kernel call
+constexpr unsigned MAX_KEY_LENGTH = 16;        // the CLI and the GUI cut keys to 16 characters
+
+struct KnownPair {
+    unsigned char plaintext[BLOCK_SIZE];
+    unsigned char ciphertext[BLOCK_SIZE];
+};
+
+struct SearchSpec {
+    string alphabet = "abcdefghijklmnopqrstuvwxyz0123456789";
+    unsigned minLength = 1;
+    unsigned maxLength = 6;
+    bool distinct = false; // try only the first candidate of every key word
+};
+
+// Candidates are numbered length by length, in alphabet order within one length
+struct Keyspace {
+    SearchSpec spec;
+    uint64_t firstIndex[MAX_KEY_LENGTH + 2] = {}; // number of candidates shorter than L
+    uint64_t total = 0;
+};
+
+enum CandidateKind {
+    DISTINCT_WORD,   // first candidate of the spec with this key word
+    PERIODIC_ALIAS,  // a shorter key of the spec repeats to the same word ("abab" and "ab")
+    LONG_ALIAS,      // longer than 8 characters: the extra characters are never used
+};
+
+struct SearchState {
+    const Keyspace* keyspace;
+    vector<KnownPair> pairs;
+    size_t maxMatches = 20;
+
+    atomic<uint64_t> enumerated{0};
+    atomic<uint64_t> tested{0};
+    atomic<uint64_t> kindCounts[3] = {};
+    atomic<uint64_t> firstBlockMatches{0};
+    atomic<uint64_t> confirmedMatches{0};
+
+    mutex matchLock;
+    vector<uint64_t> matchIndices; // the first maxMatches confirmed candidates
+};
+
+bool buildKeyspace(const SearchSpec& spec, Keyspace& keyspace){
+    const string& alphabet = spec.alphabet;
+    if(alphabet.empty()){
+        cout << "Error: The alphabet is empty." << endl;
+        return false;
+    }
+    for(size_t i = 0; i < alphabet.size(); i++){
+        if(alphabet.find(alphabet[i], i + 1) != string::npos){
+            cout << "Error: The alphabet repeats the character '" << alphabet[i] << "'." << endl;
+            return false;
+        }
+    }
+    if(spec.minLength < 1 || spec.maxLength > MAX_KEY_LENGTH || spec.minLength > spec.maxLength){
+        cout << "Error: Key lengths must satisfy 1 <= min <= max <= " << MAX_KEY_LENGTH << "." << endl;
+        return false;
+    }
+    keyspace.spec = spec;
+    keyspace.total = 0;
+    for(unsigned length = spec.minLength; length <= spec.maxLength; length++){
+        uint64_t count = 1;
+        for(unsigned i = 0; i < length; i++){
+            if(count > UINT64_MAX / alphabet.size()) count = 0;
+            count *= alphabet.size();
+        }
+        keyspace.firstIndex[length] = keyspace.total;
+        if(count == 0 || keyspace.total > UINT64_MAX - count){
+            cout << "Error: The key space does not fit in 64 bits. Keys longer than 8 characters only add"
+                 << " aliases of their first 8 characters, so --max-length 8 covers every key word." << endl;
+            return false;
+        }
+        keyspace.total += count;
+    }
+    keyspace.firstIndex[spec.maxLength + 1] = keyspace.total;
+    return true;
+}
+
+// Length and digits (alphabet positions, first character most significant) of a candidate
+unsigned decodeCandidate(const Keyspace& keyspace, uint64_t index, unsigned char (&digits)[MAX_KEY_LENGTH]){
+    unsigned length = keyspace.spec.minLength;
+    while(index >= keyspace.firstIndex[length + 1]) length++;
+    uint64_t rest = index - keyspace.firstIndex[length];
+    const size_t radix = keyspace.spec.alphabet.size();
+    for(unsigned i = length; i-- > 0; ){
+        digits[i] = (unsigned char)(rest % radix);
+        rest /= radix;
+    }
+    return length;
+}
+
+string candidateKey(const Keyspace& keyspace, uint64_t index){
+    unsigned char digits[MAX_KEY_LENGTH];
+    unsigned length = decodeCandidate(keyspace, index, digits);
+    string key(length, '\0');
+    for(unsigned i = 0; i < length; i++) key[i] = keyspace.spec.alphabet[digits[i]];
+    return key;
+}
+
+// What the classification of a candidate needs to know about its length
+struct LengthInfo {
+    unsigned length;
+    unsigned shorterLengths; // bit p: p is a length of the spec shorter than this one (p <= 8)
+    uint64_t shorterBytes;   // high bit of byte p for every such p < 8
+    uint64_t lastPositions;  // bytes of the key word taken from the last character (none past 8)
+};
+
+LengthInfo lengthInfo(unsigned length, const SearchSpec& spec){
+    LengthInfo info;
+    info.length = length;
+    info.shorterLengths = ((1u << min<unsigned>(length, BLOCK_SIZE + 1)) - 1) & ~((1u << spec.minLength) - 1);
+    info.shorterBytes = 0;
+    info.lastPositions = 0;
+    for(unsigned p = 1; p < BLOCK_SIZE; p++){
+        if(info.shorterLengths & (1u << p)) info.shorterBytes |= (uint64_t)0x80 << (8 * p);
+    }
+    for(unsigned i = length - 1; i < BLOCK_SIZE; i += length) info.lastPositions |= (uint64_t)0xFF << (8 * i);
+    return info;
+}
+
+// True when the key word repeats with period p for one of the shorter lengths p, i.e.
+// when the key made of its first p characters is in the spec and has the same word
+bool shorterKeyHasWord(uint64_t word, const LengthInfo& info){
+    if(info.shorterLengths & (1u << BLOCK_SIZE)) return true; // any 8-character prefix repeats with period 8
+    // Period p needs byte p equal to byte 0, which rules out most words at once
+    const uint64_t low = 0x0101010101010101ULL, high = 0x8080808080808080ULL;
+    uint64_t diff = word ^ (low * (word & 0xFF));
+    if(((diff - low) & ~diff & high & info.shorterBytes) == 0) return false;
+    for(int p = 1; p < BLOCK_SIZE; p++){
+        uint64_t overlap = ((uint64_t)1 << (8 * (BLOCK_SIZE - p))) - 1;
+        if((info.shorterLengths & (1u << p)) && ((word ^ (word >> (8 * p))) & overlap) == 0) return true;
+    }
+    return false;
+}
+
+CandidateKind classifyCandidate(uint64_t word, const unsigned char* digits, const LengthInfo& info, const SearchSpec& spec){
+    bool shorterKey = shorterKeyHasWord(word, info);
+    if(info.length <= BLOCK_SIZE) return shorterKey ? PERIODIC_ALIAS : DISTINCT_WORD;
+    // With no short key for the word, the shortest long candidate whose extra characters
+    // are all the first of the alphabet stands for it
+    if(shorterKey || info.length != max<unsigned>(spec.minLength, BLOCK_SIZE + 1)) return LONG_ALIAS;
+    for(unsigned i = BLOCK_SIZE; i < info.length; i++){
+        if(digits[i] != 0) return LONG_ALIAS;
+    }
+    return DISTINCT_WORD;
+}
+
+// ===================== SEARCH =====================
+
+// Key word of a candidate (see keyWord())
+uint64_t candidateWord(const unsigned char* digits, unsigned length, const unsigned char* alphabet){
+    uint64_t word = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++){
+        word |= (uint64_t)alphabet[digits[i % length]] << (8 * i);
+    }
+    return word;
+}
+
+struct LaneBatch {
+    unsigned char plaintexts[LANE_BATCH * BLOCK_SIZE]; // the first known plaintext in every lane
+    unsigned char blocks[LANE_BATCH * BLOCK_SIZE];
+    uint64_t subkeyWords[LANE_BATCH][TOTAL_ROUNDS];
+    const uint64_t* keys[LANE_BATCH];
+    uint64_t indices[LANE_BATCH];
+};
+
+// Encrypts the first known block under every candidate of the batch and checks survivors against the other pairs
+void testBatch(SearchState& state, LaneBatch& batch, size_t lanes, KeyedBlockFunction encrypt){
+    const KnownPair& first = state.pairs[0];
+    encrypt(batch.plaintexts, batch.blocks, lanes, batch.keys);
+    for(size_t lane = 0; lane < lanes; lane++){
+        if(memcmp(batch.blocks + lane * BLOCK_SIZE, first.ciphertext, BLOCK_SIZE) != 0) continue;
+        state.firstBlockMatches++;
+        bool confirmed = true;
+        for(size_t p = 1; p < state.pairs.size() && confirmed; p++){
+            unsigned char block[BLOCK_SIZE];
+            encryptBlocksKeyed(state.pairs[p].plaintext, block, 1, &batch.keys[lane]);
+            confirmed = memcmp(block, state.pairs[p].ciphertext, BLOCK_SIZE) == 0;
+        }
+        if(!confirmed) continue;
+        state.confirmedMatches++;
+        lock_guard<mutex> lock(state.matchLock);
+        if(state.matchIndices.size() < state.maxMatches) state.matchIndices.push_back(batch.indices[lane]);
+    }
+}
+
+void searchChunk(SearchState& state, uint64_t first, uint64_t count){
+    const Keyspace& keyspace = *state.keyspace;
+    const SearchSpec& spec = keyspace.spec;
+    const unsigned char* alphabet = (const unsigned char*)spec.alphabet.data();
+    const unsigned radix = (unsigned)spec.alphabet.size();
+    KeyedBlockFunction encrypt = keyedBlockVariant().encrypt;
+
+    unsigned char digits[MAX_KEY_LENGTH];
+    unsigned length = decodeCandidate(keyspace, first, digits);
+    uint64_t word = candidateWord(digits, length, alphabet);
+    LengthInfo info = lengthInfo(length, spec);
+    LaneBatch batch;
+    for(size_t lane = 0; lane < LANE_BATCH; lane++){
+        memcpy(batch.plaintexts + lane * BLOCK_SIZE, state.pairs[0].plaintext, BLOCK_SIZE);
+    }
+    size_t lanes = 0;
+    uint64_t tested = 0;
+    uint64_t kindCounts[3] = {0, 0, 0};
+
+    for(uint64_t n = 0; n < count; n++){
+        CandidateKind kind = classifyCandidate(word, digits, info, spec);
+        kindCounts[kind]++;
+        if(!spec.distinct || kind == DISTINCT_WORD){
+            expandKeyWord(word, batch.subkeyWords[lanes]);
+            batch.keys[lanes] = batch.subkeyWords[lanes];
+            batch.indices[lanes] = first + n;
+            if(++lanes == LANE_BATCH){
+                testBatch(state, batch, lanes, encrypt);
+                tested += lanes;
+                lanes = 0;
+            }
+        }
+
+        // Next candidate: count up in the alphabet, or move on to the next length.
+        // Without a carry only the bytes of the last character change.
+        unsigned i = length;
+        while(i > 0 && ++digits[i - 1] == radix) digits[--i] = 0;
+        if(i == length){
+            word = (word & ~info.lastPositions) | (0x0101010101010101ULL * alphabet[digits[length - 1]] & info.lastPositions);
+            continue;
+        }
+        if(i == 0 && length < MAX_KEY_LENGTH){
+            length++;
+            memset(digits, 0, length);
+            info = lengthInfo(length, spec);
+        }
+        word = candidateWord(digits, length, alphabet);
+    }
+    if(lanes > 0){
+        testBatch(state, batch, lanes, encrypt);
+        tested += lanes;
+    }
+
+    state.enumerated += count;
+    state.tested += tested;
+    for(int kind = 0; kind < 3; kind++) state.kindCounts[kind] += kindCounts[kind];
+}
+
+// Runs the keyspace in waves of chunks on the pool until it is done or seconds have passed
+double runSearch(SearchState& state, double seconds){
+    WorkStealingPool& pool = sharedPool();
+    const uint64_t total = state.keyspace->total;
+    const size_t wave = pool.threadCount() * CHUNKS_PER_THREAD;
+    auto start = chrono::steady_clock::now();
+    auto lastProgress = start;
+    uint64_t next = 0;
+    while(next < total){
+        uint64_t waveStart = next;
+        size_t chunks = (size_t)min<uint64_t>(wave, (total - waveStart + CHUNK_CANDIDATES - 1) / CHUNK_CANDIDATES);
+        pool.parallelFor(chunks, [&](size_t chunk){
+            uint64_t first = waveStart + chunk * CHUNK_CANDIDATES;
+            searchChunk(state, first, min<uint64_t>(CHUNK_CANDIDATES, total - first));
+        });
+        next = min<uint64_t>(total, waveStart + (uint64_t)chunks * CHUNK_CANDIDATES);
+
+        auto now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - start).count();
+        if(seconds > 0 && elapsed >= seconds) break;
+        if(chrono::duration<double>(now - lastProgress).count() >= 1.0){
+            cerr << "\r  " << fixed << setprecision(1) << 100.0 * next / total << "% searched" << flush;
+            lastProgress = now;
+        }
+    }
+    if(lastProgress != start) cerr << "\r" << string(24, ' ') << "\r";
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// ===================== REPORT =====================
+
+string formatDuration(double seconds){
+    ostringstream text;
+    text << fixed << setprecision(1);
+    if(seconds < 120) text << seconds << " s";
+    else if(seconds < 2 * 3600) text << seconds / 60 << " min";
+    else if(seconds < 2 * 86400) text << seconds / 3600 << " h";
+    else if(seconds < 2 * 31557600) text << seconds / 86400 << " days";
+    else text << scientific << setprecision(2) << seconds / 31557600 << " years";
+    return text.str();
+}
+
+string percent(uint64_t part, uint64_t whole){
+    ostringstream text;
+    text << fixed << setprecision(2) << (whole ? 100.0 * part / whole : 0.0) << "%";
+    return text.str();
+}
+
+void printReport(SearchState& state, double seconds){
+    const Keyspace& keyspace = *state.keyspace;
+    const SearchSpec& spec = keyspace.spec;
+    uint64_t enumerated = state.enumerated, tested = state.tested;
+    unsigned threads = sharedPool().threadCount();
+    double rate = seconds > 0 ? tested / seconds : 0;
+
+    cout << "Backend: " << blockBackend().name << ", threads: " << threads << endl;
+    cout << "Key space: " << spec.alphabet.size() << " characters, lengths " << spec.minLength << ".." << spec.maxLength
+         << ": " << keyspace.total << " candidates" << endl;
+    cout << fixed << setprecision(2);
+    cout << "Searched " << enumerated << " candidates (" << percent(enumerated, keyspace.total) << ") in "
+         << formatDuration(seconds) << "; tested " << tested << (spec.distinct ? " distinct key words" : " keys") << endl;
+    cout << "Rate: " << rate / 1e6 << " M keys/s, " << rate / threads / 1e6 << " M keys/s per core" << endl;
+    if(enumerated < keyspace.total && enumerated > 0){
+        cout << "Whole key space at this rate: " << formatDuration(seconds * keyspace.total / enumerated) << endl;
+    }
+
+    cout << "First-block matches: " << state.firstBlockMatches;
+    if(state.pairs.size() > 1){
+        cout << ", confirmed by " << state.pairs.size() - 1 << " more pair(s): " << state.confirmedMatches;
+    }
+    cout << endl;
+    vector<uint64_t> matches = state.matchIndices;
+    sort(matches.begin(), matches.end());
+    for(uint64_t index : matches){
+        string key = candidateKey(keyspace, index);
+        cout << "  \"" << key << "\" (key word " << hex << setw(16) << setfill('0') << keyWord(key)
+             << dec << setfill(' ') << ")" << endl;
+    }
+    if(state.confirmedMatches > matches.size()){
+        cout << "  ... and " << state.confirmedMatches - matches.size() << " more" << endl;
+    }
+
+    // Only the first 8 key characters reach the 8-byte subkeys, and a key that repeats
+    // within them gives the same subkeys as its shortest period
+    uint64_t distinct = state.kindCounts[DISTINCT_WORD];
+    uint64_t periodic = state.kindCounts[PERIODIC_ALIAS];
+    uint64_t longKeys = state.kindCounts[LONG_ALIAS];
+    cout << "Key-space collisions among the searched candidates (8-byte blocks):" << endl;
+    cout << "  distinct key words: " << distinct << " (" << percent(distinct, enumerated) << ")" << endl;
+    cout << "  periodic aliases:   " << periodic << " (" << percent(periodic, enumerated)
+         << "), e.g. \"abab\" has the subkeys of \"ab\"" << endl;
+    cout << "  longer than 8:      " << longKeys << " (" << percent(longKeys, enumerated)
+         << "), characters past the 8th are never used" << endl;
+    if(distinct > 0){
+        cout << "  candidates per key word: " << (double)enumerated / distinct << endl;
+    }
+}
+
+// ===================== MAIN =====================
+
+bool parseBlock(const string& hexText, unsigned char (&block)[BLOCK_SIZE]){
+    vector<unsigned char> bytes;
+    if(!hexStringToBytes(hexText, bytes)) return false;
+    if(bytes.size() != BLOCK_SIZE){
+        cout << "Error: A known block must be " << BLOCK_SIZE * 2 << " hex digits." << endl;
+        return false;
+    }
+    memcpy(block, bytes.data(), BLOCK_SIZE);
+    return true;
+}
+
+// Two known blocks encrypted with the key, printed so they can be reused with --pair
+vector<KnownPair> targetPairs(const string& key){
+    static const char* const plaintexts[] = {"BitCasca", "de audit"};
+    KeySchedule schedule(key);
+    vector<KnownPair> pairs;
+    for(const char* plaintext : plaintexts){
+        KnownPair pair;
+        memcpy(pair.plaintext, plaintext, BLOCK_SIZE);
+        encryptBlocks(pair.plaintext, pair.ciphertext, 1, schedule);
+        cout << "Known pair: " << bytesToHexString(vector<unsigned char>(pair.plaintext, pair.plaintext + BLOCK_SIZE))
+             << " " << bytesToHexString(vector<unsigned char>(pair.ciphertext, pair.ciphertext + BLOCK_SIZE)) << endl;
+        pairs.push_back(pair);
+    }
+    return pairs;
+}
+
+int usage(const char* program){
+    cout << "Usage: " << program << " (--pair PLAIN_HEX CIPHER_HEX ... | --target KEY) [--alphabet CHARS]"
+         << " [--min-length N] [--max-length N] [--distinct] [--threads N] [--seconds S]"
+         << " [--backend NAME] [--max-matches N]" << endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]){
+    SearchSpec spec;
+    vector<KnownPair> pairs;
+    string target, backendName;
+    unsigned threads = 0;
+    double seconds = 0;
+    size_t maxMatches = 20;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool ok = true;
+        if(arg == "--pair" && i + 2 < argc){
+            KnownPair pair;
+            ok = parseBlock(argv[i + 1], pair.plaintext) && parseBlock(argv[i + 2], pair.ciphertext);
+            pairs.push_back(pair);
+            i += 2;
+        } else if(arg == "--target" && i + 1 < argc){
+            target = argv[++i];
+            ok = !target.empty();
+        } else if(arg == "--alphabet" && i + 1 < argc){
+            spec.alphabet = argv[++i];
+        } else if(arg == "--min-length" && i + 1 < argc){
+            spec.minLength = (unsigned)atoi(argv[++i]);
+        } else if(arg == "--max-length" && i + 1 < argc){
+            spec.maxLength = (unsigned)atoi(argv[++i]);
+        } else if(arg == "--distinct"){
+            spec.distinct = true;
+        } else if(arg == "--threads" && i + 1 < argc){
+            threads = (unsigned)atoi(argv[++i]);
+        } else if(arg == "--seconds" && i + 1 < argc){
+            seconds = atof(argv[++i]);
+        } else if(arg == "--backend" && i + 1 < argc){
+            backendName = argv[++i];
+        } else if(arg == "--max-matches" && i + 1 < argc){
+            maxMatches = (size_t)atoll(argv[++i]);
+        } else {
+            ok = false;
+        }
+        if(!ok) return usage(argv[0]);
+    }
+    if(pairs.empty() && target.empty()) return usage(argv[0]);
+    if(!backendName.empty() && !selectBackend(backendName)) return 1;
+    setSharedPoolThreads(threads);
+
+    Keyspace keyspace;
+    if(!buildKeyspace(spec, keyspace)) return 1;
+    if(!target.empty()){
+        vector<KnownPair> generated = targetPairs(target);
+        pairs.insert(pairs.end(), generated.begin(), generated.end());
+    }
+
+    SearchState state;
+    state.keyspace = &keyspace;
+    state.pairs = pairs;
+    state.maxMatches = maxMatches;
+    double elapsed = runSearch(state, seconds);
+    printReport(state, elapsed);
+    return 0;
+}
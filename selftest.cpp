@@ -0,0 +1,247 @@
+// Checks every block kernel against the reference encryptBlock/decryptBlock.
+//
+//   selftest.exe [--rounds N] [--seed N]
+//
+// Every backend the CPU supports is selected in turn. Its 8-byte kernels, the wide-block
+// kernels blockVariant() picks for it and its multi-key kernels run on random keys, data
+// and block counts, out of place and in place. Wide blocks are compared with the reference
+// round steps written out for the whole block with the wide subkeys. Container headers with
+// crafted lengths must be rejected. Exits with 1 on a mismatch.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include "bitcascade.h"
+using namespace std;
+
+struct SelfTest {
+    mt19937_64 random;
+    unsigned rounds = 50;
+    size_t checks = 0;
+    size_t failures = 0;
+    const char* backend = "";
+
+    string randomKey(){
+        string key(1 + random() % 24, '\0');
+        for(char& c : key) c = (char)(33 + random() % 94);
+        return key;
+    }
+
+    // Mostly short runs, which hit the SIMD tail paths, and now and then a long one
+    size_t randomBlockCount(){
+        return (random() % 4 == 0) ? 1 + random() % 1024 : 1 + random() % 40;
+    }
+
+    vector<unsigned char> randomBytes(size_t length){
+        vector<unsigned char> bytes(length);
+        for(unsigned char& byte : bytes) byte = (unsigned char)random();
+        return bytes;
+    }
+
+    // Reports the first block where actual differs from expected
+    void compare(const vector<unsigned char>& actual, const vector<unsigned char>& expected, size_t blockSize,
+                 const string& what){
+        checks++;
+        if(actual == expected) return;
+        failures++;
+        size_t byte = 0;
+        while(actual[byte] == expected[byte]) byte++;
+        cout << "Mismatch: backend " << backend << ", " << what << ", block " << byte / blockSize
+             << " of " << expected.size() / blockSize << "." << endl;
+    }
+
+    void expect(bool condition, const string& what){
+        checks++;
+        if(condition) return;
+        failures++;
+        cout << "Failed: " << what << "." << endl;
+    }
+};
+
+// ===================== REFERENCE =====================
+
+vector<unsigned char> referenceEncrypt(const vector<unsigned char>& data, const KeySchedule& schedule){
+    vector<unsigned char> out;
+    for(size_t b = 0; b < data.size(); b += BLOCK_SIZE){
+        vector<unsigned char> block = encryptBlock(vector<unsigned char>(data.begin() + b, data.begin() + b + BLOCK_SIZE), schedule);
+        out.insert(out.end(), block.begin(), block.end());
+    }
+    return out;
+}
+
+// confusion() with one subkey byte per position of a wide block
+void wideConfusion(vector<unsigned char>& block, const unsigned char* subkey, int round){
+    for(size_t i = 0; i < block.size(); i++){
+        block[i] = (unsigned char)((block[i] ^ subkey[i]) + i * i + round * 7);
+    }
+}
+
+// difusion() with the rotation amount taken mod 8, as it is past the eighth byte
+void wideDifusion(vector<unsigned char>& block){
+    for(size_t i = 0; i < block.size(); i++){
+        unsigned n = (unsigned)((i + 1) % 8);
+        if(n != 0) block[i] = rotateLeft(block[i], (int)n);
+    }
+    for(size_t i = 1; i < block.size(); i++){
+        block[i] ^= block[i - 1];
+    }
+    vector<unsigned char> moved(block.size());
+    for(size_t i = 0; i < block.size(); i++){
+        size_t j = (i % 2 == 0) ? (block.size() - 1 - i / 2) : (i / 2);
+        moved[j] = block[i];
+    }
+    block = moved;
+}
+
+vector<unsigned char> referenceEncryptWide(const vector<unsigned char>& data, const KeySchedule& schedule){
+    const size_t blockSize = schedule.blockSize;
+    vector<unsigned char> out;
+    for(size_t b = 0; b < data.size(); b += blockSize){
+        vector<unsigned char> block(data.begin() + b, data.begin() + b + blockSize);
+        for(int round = 0; round < TOTAL_ROUNDS; round++){
+            wideConfusion(block, schedule.wideSubkeys[round], round);
+            wideDifusion(block);
+        }
+        out.insert(out.end(), block.begin(), block.end());
+    }
+    return out;
+}
+
+// ===================== CHECKS =====================
+
+// Runs encrypt and decrypt out of place, then decrypt in place over the ciphertext
+void checkKernels(SelfTest& test, BlockFunction encrypt, BlockFunction decrypt, const KeySchedule& schedule,
+                  const string& what){
+    const size_t blockSize = schedule.blockSize;
+    size_t blockCount = test.randomBlockCount();
+    vector<unsigned char> plaintext = test.randomBytes(blockCount * blockSize);
+    vector<unsigned char> expected = blockSize == BLOCK_SIZE ? referenceEncrypt(plaintext, schedule)
+                                                             : referenceEncryptWide(plaintext, schedule);
+    vector<unsigned char> ciphertext(plaintext.size());
+    encrypt(plaintext.data(), ciphertext.data(), blockCount, schedule);
+    test.compare(ciphertext, expected, blockSize, what + " encrypt");
+
+    vector<unsigned char> decrypted(plaintext.size());
+    decrypt(expected.data(), decrypted.data(), blockCount, schedule);
+    test.compare(decrypted, plaintext, blockSize, what + " decrypt");
+    decrypt(expected.data(), expected.data(), blockCount, schedule);
+    test.compare(expected, plaintext, blockSize, what + " decrypt in place");
+}
+
+void checkBlockVariants(SelfTest& test, const BlockBackend& backend){
+    KeySchedule schedule(test.randomKey());
+    checkKernels(test, backend.encrypt, backend.decrypt, schedule, "8-byte blocks");
+    for(unsigned blockSize : {16u, 32u, 64u}){
+        KeySchedule wide = schedule.withBlockSize(blockSize);
+        BlockVariant variant = blockVariant(wide);
+        checkKernels(test, variant.encrypt, variant.decrypt, wide, to_string(blockSize) + "-byte blocks");
+    }
+}
+
+// Neighbouring blocks get different keys, picked from a few schedules
+void checkKeyedVariant(SelfTest& test){
+    vector<KeySchedule> schedules;
+    size_t keyCount = 1 + test.random() % 8;
+    for(size_t k = 0; k < keyCount; k++) schedules.emplace_back(test.randomKey());
+
+    size_t blockCount = test.randomBlockCount();
+    vector<unsigned char> plaintext = test.randomBytes(blockCount * BLOCK_SIZE);
+    vector<unsigned char> expected;
+    vector<const uint64_t*> blockKeys(blockCount);
+    for(size_t b = 0; b < blockCount; b++){
+        const KeySchedule& schedule = schedules[test.random() % keyCount];
+        blockKeys[b] = schedule.subkeyWords;
+        vector<unsigned char> block(plaintext.begin() + b * BLOCK_SIZE, plaintext.begin() + (b + 1) * BLOCK_SIZE);
+        block = encryptBlock(block, schedule);
+        expected.insert(expected.end(), block.begin(), block.end());
+    }
+
+    KeyedBlockVariant variant = keyedBlockVariant();
+    vector<unsigned char> ciphertext(plaintext.size());
+    variant.encrypt(plaintext.data(), ciphertext.data(), blockCount, blockKeys.data());
+    test.compare(ciphertext, expected, BLOCK_SIZE, "multi-key encrypt");
+
+    vector<unsigned char> decrypted(plaintext.size());
+    variant.decrypt(expected.data(), decrypted.data(), blockCount, blockKeys.data());
+    test.compare(decrypted, plaintext, BLOCK_SIZE, "multi-key decrypt");
+    variant.decrypt(expected.data(), expected.data(), blockCount, blockKeys.data());
+    test.compare(expected, plaintext, BLOCK_SIZE, "multi-key decrypt in place");
+}
+
+// ===================== CONTAINERS =====================
+
+// Headers whose original length is near UINT64_MAX, where paddedLength() wraps around to a
+// small value, must match neither an empty payload nor one of the wrapped length
+void checkContainerLengths(SelfTest& test){
+    const uint64_t lengths[] = {UINT64_MAX, UINT64_MAX - 1, UINT64_MAX - 63, UINT64_MAX / 2 + 1};
+    for(unsigned blockSize : {8u, 16u, 32u, 64u}){
+        for(ContainerMode mode : {MODE_ECB, MODE_CTR}){
+            for(uint64_t length : lengths){
+                ContainerHeader header = makeContainerHeader(length, KeySchedule("key", blockSize), mode);
+                uint64_t wrapped = containerPayloadLength(header);
+                vector<uint64_t> payloads = {0};
+                if(wrapped != 0 && wrapped < 4096) payloads.push_back(wrapped);
+                for(uint64_t payload : payloads){
+                    string what = to_string(blockSize) + "-byte " + (mode == MODE_CTR ? "CTR" : "ECB") +
+                                  " header with original length " + to_string(length) + " and " +
+                                  to_string(payload) + " payload bytes";
+                    test.expect(!containerLengthMatches(header, payload), what + " matches");
+
+                    unsigned char encoded[CONTAINER_MAX_HEADER_SIZE];
+                    string content((const char*)encoded, encodeContainerHeader(header, encoded));
+                    content.append((size_t)payload, '\0');
+                    vector<unsigned char> ciphertext;
+                    ContainerHeader parsed;
+                    bool hasHeader = false;
+                    test.expect(!parseCiphertext(content, ciphertext, parsed, hasHeader), what + " is accepted by parseCiphertext");
+                }
+            }
+            ContainerHeader header = makeContainerHeader(100, KeySchedule("key", blockSize), mode);
+            test.expect(containerLengthMatches(header, containerPayloadLength(header)),
+                        to_string(blockSize) + "-byte header of a 100-byte plaintext is rejected");
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    SelfTest test;
+    uint64_t seed = random_device()();
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "--rounds" && i + 1 < argc){
+            test.rounds = (unsigned)atoi(argv[++i]);
+        } else if(arg == "--seed" && i + 1 < argc){
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            cout << "Usage: " << argv[0] << " [--rounds N] [--seed N]" << endl;
+            return 1;
+        }
+    }
+    test.random.seed(seed);
+    cout << "Seed " << seed << endl;
+
+    for(size_t i = 0; i < BLOCK_BACKEND_COUNT; i++){
+        const BlockBackend& backend = BLOCK_BACKENDS[i];
+        if(!backend.supported()){
+            cout << backend.name << ": skipped, not supported by this CPU" << endl;
+            continue;
+        }
+        selectBackend(backend.name);
+        test.backend = backend.name;
+        size_t failuresBefore = test.failures;
+        for(unsigned round = 0; round < test.rounds; round++){
+            checkBlockVariants(test, backend);
+            checkKeyedVariant(test);
+        }
+        cout << backend.name << ": " << (test.failures == failuresBefore ? "ok" : "FAILED") << endl;
+    }
+
+    size_t failuresBefore = test.failures;
+    checkContainerLengths(test);
+    cout << "containers: " << (test.failures == failuresBefore ? "ok" : "FAILED") << endl;
+
+    cout << test.checks << " checks, " << test.failures << " failures" << endl;
+    return test.failures == 0 ? 0 : 1;
+}